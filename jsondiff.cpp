@@ -0,0 +1,659 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsondiff.h"
+#include "jsonfootprint.h"
+
+#include <wx/debug.h>
+
+
+/*! \class wxJSONDiff
+ \brief Compare two JSON documents without reading them in memory
+
+ The class compares two JSON texts read from two input streams and
+ returns their differences as a JSON Patch (RFC 6902): an array of
+ operations that transform the \e from document into the \e to document.
+
+ The documents are not read into wxJSONValue trees: the two texts are
+ read in lockstep, one token at a time, by two parsers and only the
+ values that differ are stored (in the patch).
+ Memory use is proportional to the nesting depth of the documents and to
+ the size of the differences, so that very large documents (for example
+ two daily exports of a database) can be compared, \b provided that the
+ members of their objects are written in the same order.
+
+ The parsers resynchronize on object member names and on array indexes:
+
+ \li the members of two objects are compared by name; when the names of
+    the current members differ, the member of one of the documents is read
+    and kept aside until a member with the same name is found in the other
+    document, so that members that were inserted, removed or moved are
+    found. Members whose order does not change are compared as they are
+    read; when their order changes they are compared in memory
+    (DiffValues()).
+    Note that wxJSONWriter writes the members of an object in the order of
+    its hash map, which is not the same for two objects with the same
+    members that were built in a different way: in the worst case all the
+    members of an object are read in memory before the first one is
+    compared. SetMaxPending() limits the memory used by these members:
+    when the limit is exceeded, the comparison stops with an error.
+ \li the elements of two arrays are compared by index: elements that are
+    inserted in the middle of an array are reported as changes of all the
+    elements that follow.
+
+ The operations are:
+ \li \c replace: a value whose type or content changed
+ \li \c add: a new object member or an element added at the end of an array
+    (path "/-")
+ \li \c remove: a member or element that is not in the \e to document;
+    trailing array elements are removed at the same index, one after the
+    other
+
+ Numbers are compared by value (see wxJSONValue::IsSameAs()).
+ The comparison stops at the first syntax error in either document: the
+ errors are returned by GetErrors() and the patch is not complete.
+
+ \par Example:
+
+ \code
+  wxFFileInputStream yesterday( _T("export-0501.json"), _T("r"));
+  wxFFileInputStream today( _T("export-0502.json"), _T("r"));
+
+  wxJSONDiff  differ;
+  wxJSONValue patch;
+  if ( differ.Diff( yesterday, today, patch ) == 0 )  {
+    wxJSONWriter writer;
+    writer.Write( patch, patchText );
+  }
+ \endcode
+*/
+
+enum {
+    wxJSONEVENT_END = 0,
+    wxJSONEVENT_OBJECT_BEGIN,
+    wxJSONEVENT_OBJECT_END,
+    wxJSONEVENT_ARRAY_BEGIN,
+    wxJSONEVENT_ARRAY_END,
+    wxJSONEVENT_KEY,
+    wxJSONEVENT_VALUE
+};
+
+/*!
+ \class wxJSONEventReader
+ \brief A parser that returns the tokens of a JSON text one at a time
+
+ The class uses the lexer functions of wxJSONReader to read one token
+ (an open/close object/array character, a member's name or a value) at a
+ time from the input stream.
+ Commas and colons are only separators: the structure of the text is not
+ checked by this class but by the caller, which knows what it expects.
+*/
+class wxJSONEventReader : public wxJSONReader
+{
+public:
+    wxJSONEventReader( wxInputStream& is, int flags, int maxErrors )
+        : wxJSONReader( flags, maxErrors ), m_is( is )
+    {
+        m_lineNo   = 1;
+        m_colNo    = 1;
+        m_peekChar = -1;
+        m_ch       = 0;
+        m_level    = 0;
+        m_depth    = 0;
+    }
+
+    int  Next( wxJSONValue& val );
+    void ReadTree( int event, wxJSONValue& val );
+    void Skip( int event );
+    void AddError( const wxString& msg )
+    {
+        wxJSONReader::AddError( msg );
+    }
+
+protected:
+    int  SkipSpaces( int ch );
+
+    wxInputStream& m_is;
+    int            m_ch;
+};
+
+// skip whitespaces and comments starting at 'ch'
+int
+wxJSONEventReader::SkipSpaces( int ch )
+{
+    for ( ;; )  {
+        switch ( ch )  {
+            case ' ' :
+            case '\t' :
+            case '\n' :
+            case '\r' :
+                ch = SkipWhiteSpace( m_is );
+                break;
+            case '/' :
+                ch = SkipComment( m_is );
+                m_comment.clear();
+                break;
+            default :
+                return ch;
+        }
+    }
+}
+
+/*!
+ Read the next token and return its type.
+ For \c wxJSONEVENT_KEY, \c val gets the member's name; for
+ \c wxJSONEVENT_VALUE, \c val gets the value; otherwise \c val is
+ invalid.
+*/
+int
+wxJSONEventReader::Next( wxJSONValue& val )
+{
+    val.SetType( wxJSONTYPE_INVALID );
+    int ch = m_ch == 0 ? ReadChar( m_is ) : m_ch;
+    for ( ;; )  {
+        ch = SkipSpaces( ch );
+        switch ( ch )  {
+            case ',' :
+            case ':' :
+                ch = ReadChar( m_is );
+                break;
+            case -1 :
+                m_ch = -1;
+                return wxJSONEVENT_END;
+            case '{' :
+                m_ch = 0;
+                return wxJSONEVENT_OBJECT_BEGIN;
+            case '}' :
+                m_ch = 0;
+                return wxJSONEVENT_OBJECT_END;
+            case '[' :
+                m_ch = 0;
+                return wxJSONEVENT_ARRAY_BEGIN;
+            case ']' :
+                m_ch = 0;
+                return wxJSONEVENT_ARRAY_END;
+            case '\"' :
+                ch = SkipSpaces( ReadString( m_is, val ));
+                if ( ch == ':' )  {
+                    m_ch = 0;
+                    return wxJSONEVENT_KEY;
+                }
+                m_ch = ch;
+                return wxJSONEVENT_VALUE;
+            case '\'' :
+                m_ch = ReadMemoryBuff( m_is, val );
+                return wxJSONEVENT_VALUE;
+            default :
+                m_ch = ReadValue( m_is, ch, val );
+                return wxJSONEVENT_VALUE;
+        }
+    }
+}
+
+/*!
+ Read the value whose first token, \c event, was just returned by Next()
+ and store it in \c val, which already contains the value if \c event is
+ \c wxJSONEVENT_VALUE.
+*/
+void
+wxJSONEventReader::ReadTree( int event, wxJSONValue& val )
+{
+    wxJSONValue key, item;
+    int ev;
+    switch ( event )  {
+        case wxJSONEVENT_VALUE :
+            break;
+        case wxJSONEVENT_OBJECT_BEGIN :
+            val.SetType( wxJSONTYPE_OBJECT );
+            while ( GetErrorCount() == 0 )  {
+                ev = Next( key );
+                if ( ev == wxJSONEVENT_OBJECT_END )  {
+                    break;
+                }
+                if ( ev != wxJSONEVENT_KEY )  {
+                    AddError( _T("\'name\' is missing for JSON object member"));
+                    break;
+                }
+                ev = Next( item );
+                ReadTree( ev, item );
+                val[key.AsString()] = item;
+            }
+            break;
+        case wxJSONEVENT_ARRAY_BEGIN :
+            val.SetType( wxJSONTYPE_ARRAY );
+            while ( GetErrorCount() == 0 )  {
+                ev = Next( item );
+                if ( ev == wxJSONEVENT_ARRAY_END )  {
+                    break;
+                }
+                ReadTree( ev, item );
+                val.Append( item );
+            }
+            break;
+        case wxJSONEVENT_END :
+            AddError( _T("unexpected end of file"));
+            break;
+        default :
+            AddError( _T("unexpected token: a value was expected"));
+            break;
+    }
+}
+
+//! Skip the value whose first token, \c event, was just returned by Next()
+void
+wxJSONEventReader::Skip( int event )
+{
+    wxJSONValue val;
+    int level = 0;
+    do  {
+        switch ( event )  {
+            case wxJSONEVENT_OBJECT_BEGIN :
+            case wxJSONEVENT_ARRAY_BEGIN :
+                ++level;
+                break;
+            case wxJSONEVENT_OBJECT_END :
+            case wxJSONEVENT_ARRAY_END :
+                --level;
+                break;
+            case wxJSONEVENT_END :
+                AddError( _T("unexpected end of file"));
+                return;
+            default :
+                break;
+        }
+        if ( level > 0 )  {
+            event = Next( val );
+        }
+    } while ( level > 0 && GetErrorCount() == 0 );
+}
+
+
+/*!
+ Construct a differ.
+
+ \param flags the flags of the two parsers (see wxJSONReader)
+ \param maxErrors the maximum number of errors of each parser
+*/
+wxJSONDiff::wxJSONDiff( int flags, int maxErrors )
+{
+    m_flags     = flags;
+    m_maxErrors = maxErrors;
+    m_from      = 0;
+    m_to        = 0;
+    m_patch     = 0;
+    m_failed    = false;
+    m_maxPending   = 0;
+    m_pendingBytes = 0;
+}
+
+/*!
+ Set the maximum number of bytes (as computed by wxJSONFootprint) of the
+ object members that are kept in memory because their order differs in
+ the two documents; if the members read in memory exceed this limit,
+ Diff() stops and reports an error.
+ The default is ZERO, which means no limit.
+*/
+void
+wxJSONDiff::SetMaxPending( size_t bytes )
+{
+    m_maxPending = bytes;
+}
+
+//! Return the limit set by SetMaxPending()
+size_t
+wxJSONDiff::GetMaxPending() const
+{
+    return m_maxPending;
+}
+
+wxJSONDiff::~wxJSONDiff()
+{
+}
+
+/*!
+ Compare the JSON texts read from \c from and \c to and store in \c patch
+ the JSON Patch array that transforms the first document into the second
+ one; the array is empty if the documents are equal.
+
+ Returns the number of errors found in the two documents; if it is not
+ ZERO, the patch only contains the differences found before the first
+ error.
+*/
+int
+wxJSONDiff::Diff( wxInputStream& from, wxInputStream& to, wxJSONValue& patch )
+{
+    wxJSONEventReader fromReader( from, m_flags, m_maxErrors );
+    wxJSONEventReader toReader( to, m_flags, m_maxErrors );
+    m_from   = &fromReader;
+    m_to     = &toReader;
+    m_patch  = &patch;
+    m_failed = false;
+    m_pendingBytes = 0;
+    m_errors.clear();
+
+    patch.SetType( wxJSONTYPE_ARRAY );
+
+    wxJSONValue fromVal, toVal;
+    int evFrom = m_from->Next( fromVal );
+    int evTo   = m_to->Next( toVal );
+    DiffStream( wxEmptyString, evFrom, fromVal, evTo, toVal );
+
+    size_t i;
+    const wxArrayString& fromErrors = fromReader.GetErrors();
+    for ( i = 0; i < fromErrors.GetCount(); i++ )  {
+        m_errors.Add( _T("from: ") + fromErrors[i] );
+    }
+    const wxArrayString& toErrors = toReader.GetErrors();
+    for ( i = 0; i < toErrors.GetCount(); i++ )  {
+        m_errors.Add( _T("to: ") + toErrors[i] );
+    }
+
+    m_from  = 0;
+    m_to    = 0;
+    m_patch = 0;
+    return m_errors.GetCount();
+}
+
+//! Return the errors found by the last call to Diff()
+const wxArrayString&
+wxJSONDiff::GetErrors() const
+{
+    return m_errors;
+}
+
+int
+wxJSONDiff::GetErrorCount() const
+{
+    return m_errors.GetCount();
+}
+
+// return TRUE if one of the parsers reported an error
+bool
+wxJSONDiff::Failed()
+{
+    if ( !m_failed )  {
+        m_failed = m_from->GetErrorCount() > 0 || m_to->GetErrorCount() > 0;
+    }
+    return m_failed;
+}
+
+// keep a member whose name was not found yet in the other document
+void
+wxJSONDiff::AddPending( wxJSONValue& pending, const wxString& key, const wxJSONValue& value )
+{
+    pending[key] = value;
+    m_pendingBytes += wxJSONFootprint::MemberBytes( key )
+        + wxJSONFootprint::Count( value );
+    if ( m_maxPending != 0 && m_pendingBytes > m_maxPending )  {
+        m_errors.Add( wxString::Format( _T("the members whose order differs use more than ")
+                _T("%lu bytes (see SetMaxPending())"), (unsigned long) m_maxPending ));
+        m_failed = true;
+    }
+}
+
+// forget a pending member
+void
+wxJSONDiff::RemovePending( wxJSONValue& pending, const wxString& key )
+{
+    size_t bytes = wxJSONFootprint::MemberBytes( key )
+        + wxJSONFootprint::Count( pending[key] );
+    m_pendingBytes -= bytes < m_pendingBytes ? bytes : m_pendingBytes;
+    pending.Remove( key );
+}
+
+//! Escape a member's name to be used in a JSON pointer (RFC 6901)
+wxString
+wxJSONDiff::EscapeKey( const wxString& key )
+{
+    wxString s( key );
+    s.Replace( _T("~"), _T("~0"));
+    s.Replace( _T("/"), _T("~1"));
+    return s;
+}
+
+void
+wxJSONDiff::AddOp( wxJSONValue& patch, const wxChar* op, const wxString& path,
+                const wxJSONValue* value )
+{
+    wxJSONValue& item = patch.Append( wxJSONValue( wxJSONTYPE_OBJECT ));
+    item[_T("op")]   = op;
+    item[_T("path")] = path;
+    if ( value != 0 )  {
+        item[_T("value")] = *value;
+    }
+}
+
+/*!
+ Compare two values that are stored in memory and append to \c patch the
+ operations that transform \c from into \c to; \c path is the JSON
+ pointer of the two values.
+ The function is used by Diff() for the object members whose order
+ changed but it can also be used to compare two trees.
+*/
+void
+wxJSONDiff::DiffValues( const wxString& path, const wxJSONValue& from,
+                const wxJSONValue& to, wxJSONValue& patch )
+{
+    if ( from.IsObject() && to.IsObject() )  {
+        wxArrayString names = from.GetMemberNames();
+        size_t i;
+        for ( i = 0; i < names.GetCount(); i++ )  {
+            wxString sub = path + _T("/") + EscapeKey( names[i] );
+            if ( to.HasMember( names[i] ))  {
+                DiffValues( sub, from.ItemAt( names[i] ), to.ItemAt( names[i] ), patch );
+            }
+            else  {
+                AddOp( patch, _T("remove"), sub, 0 );
+            }
+        }
+        names = to.GetMemberNames();
+        for ( i = 0; i < names.GetCount(); i++ )  {
+            if ( !from.HasMember( names[i] ))  {
+                wxJSONValue item = to.ItemAt( names[i] );
+                AddOp( patch, _T("add"), path + _T("/") + EscapeKey( names[i] ), &item );
+            }
+        }
+    }
+    else if ( from.IsArray() && to.IsArray() )  {
+        int fromSize = from.Size();
+        int toSize   = to.Size();
+        int i;
+        for ( i = 0; i < fromSize && i < toSize; i++ )  {
+            DiffValues( wxString::Format( _T("%s/%d"), path.c_str(), i ),
+                    from.ItemAt( i ), to.ItemAt( i ), patch );
+        }
+        for ( int j = i; j < fromSize; j++ )  {
+            AddOp( patch, _T("remove"), wxString::Format( _T("%s/%d"), path.c_str(), i ), 0 );
+        }
+        for ( ; i < toSize; i++ )  {
+            wxJSONValue item = to.ItemAt( i );
+            AddOp( patch, _T("add"), path + _T("/-"), &item );
+        }
+    }
+    else if ( !from.IsSameAs( to ))  {
+        AddOp( patch, _T("replace"), path, &to );
+    }
+}
+
+/*!
+ Compare the two values whose first tokens, \c evFrom and \c evTo, were
+ just read from the two documents.
+*/
+void
+wxJSONDiff::DiffStream( const wxString& path, int evFrom, wxJSONValue& from,
+                int evTo, wxJSONValue& to )
+{
+    if ( Failed() )  {
+        return;
+    }
+    if ( evFrom == wxJSONEVENT_OBJECT_BEGIN && evTo == wxJSONEVENT_OBJECT_BEGIN )  {
+        DiffObjects( path );
+    }
+    else if ( evFrom == wxJSONEVENT_ARRAY_BEGIN && evTo == wxJSONEVENT_ARRAY_BEGIN )  {
+        DiffArrays( path );
+    }
+    else if ( evFrom == wxJSONEVENT_VALUE && evTo == wxJSONEVENT_VALUE )  {
+        if ( !from.IsSameAs( to ))  {
+            AddOp( *m_patch, _T("replace"), path, &to );
+        }
+    }
+    else  {
+        // different types: the whole 'to' value replaces the 'from' one
+        m_from->Skip( evFrom );
+        m_to->ReadTree( evTo, to );
+        if ( !Failed() )  {
+            AddOp( *m_patch, _T("replace"), path, &to );
+        }
+    }
+}
+
+/*!
+ Compare two objects; the open-object characters were just read.
+ Members with the same name at the same position are compared as they
+ are read; the others are read in memory and kept in \c fromPending or
+ \c toPending until the member with the same name is found in the other
+ document (they are then compared by DiffValues()) or the object ends
+ (they are removed or added).
+ When the current names differ and none of them is pending in the other
+ document, the members are read alternately from the two documents so
+ that both an insertion and a removal resynchronize the two parsers after
+ a few members.
+*/
+void
+wxJSONDiff::DiffObjects( const wxString& path )
+{
+    wxJSONValue fromPending( wxJSONTYPE_OBJECT );
+    wxJSONValue toPending( wxJSONTYPE_OBJECT );
+    wxJSONValue fromKey, toKey, fromVal, toVal;
+    bool turnFrom = true;
+
+    int evFrom = m_from->Next( fromKey );
+    int evTo   = m_to->Next( toKey );
+    while ( !Failed() )  {
+        bool fromEnd = ( evFrom == wxJSONEVENT_OBJECT_END );
+        bool toEnd   = ( evTo == wxJSONEVENT_OBJECT_END );
+        if ( fromEnd && toEnd )  {
+            break;
+        }
+        if ( !fromEnd && evFrom != wxJSONEVENT_KEY )  {
+            m_from->AddError( _T("\'name\' is missing for JSON object member"));
+            break;
+        }
+        if ( !toEnd && evTo != wxJSONEVENT_KEY )  {
+            m_to->AddError( _T("\'name\' is missing for JSON object member"));
+            break;
+        }
+
+        if ( !fromEnd && !toEnd && fromKey.AsString() == toKey.AsString() )  {
+            wxString sub = path + _T("/") + EscapeKey( fromKey.AsString() );
+            int evFromVal = m_from->Next( fromVal );
+            int evToVal   = m_to->Next( toVal );
+            DiffStream( sub, evFromVal, fromVal, evToVal, toVal );
+            evFrom = m_from->Next( fromKey );
+            evTo   = m_to->Next( toKey );
+            continue;
+        }
+
+        bool takeFrom;
+        if ( toEnd )  {
+            takeFrom = true;
+        }
+        else if ( fromEnd )  {
+            takeFrom = false;
+        }
+        else if ( fromPending.HasMember( toKey.AsString() ))  {
+            takeFrom = false;
+        }
+        else if ( toPending.HasMember( fromKey.AsString() ))  {
+            takeFrom = true;
+        }
+        else  {
+            takeFrom = turnFrom;
+            turnFrom = !turnFrom;
+        }
+
+        if ( takeFrom )  {
+            wxString key = fromKey.AsString();
+            m_from->ReadTree( m_from->Next( fromVal ), fromVal );
+            if ( toPending.HasMember( key ))  {
+                DiffValues( path + _T("/") + EscapeKey( key ), fromVal, toPending[key], *m_patch );
+                RemovePending( toPending, key );
+            }
+            else  {
+                AddPending( fromPending, key, fromVal );
+            }
+            evFrom = m_from->Next( fromKey );
+        }
+        else  {
+            wxString key = toKey.AsString();
+            m_to->ReadTree( m_to->Next( toVal ), toVal );
+            if ( fromPending.HasMember( key ))  {
+                DiffValues( path + _T("/") + EscapeKey( key ), fromPending[key], toVal, *m_patch );
+                RemovePending( fromPending, key );
+            }
+            else  {
+                AddPending( toPending, key, toVal );
+            }
+            evTo = m_to->Next( toKey );
+        }
+    }
+    if ( Failed() )  {
+        return;
+    }
+
+    size_t i;
+    wxArrayString names = fromPending.GetMemberNames();
+    for ( i = 0; i < names.GetCount(); i++ )  {
+        AddOp( *m_patch, _T("remove"), path + _T("/") + EscapeKey( names[i] ), 0 );
+        RemovePending( fromPending, names[i] );
+    }
+    names = toPending.GetMemberNames();
+    for ( i = 0; i < names.GetCount(); i++ )  {
+        AddOp( *m_patch, _T("add"), path + _T("/") + EscapeKey( names[i] ),
+                &toPending[names[i]] );
+        RemovePending( toPending, names[i] );
+    }
+}
+
+/*!
+ Compare two arrays; the open-array characters were just read.
+ The elements are compared by index: if the \e from array is longer, its
+ last elements are removed one after the other at the same index; if the
+ \e to array is longer, its last elements are appended.
+*/
+void
+wxJSONDiff::DiffArrays( const wxString& path )
+{
+    wxJSONValue fromVal, toVal;
+    int index = 0;
+
+    int evFrom = m_from->Next( fromVal );
+    int evTo   = m_to->Next( toVal );
+    while ( !Failed() )  {
+        bool fromEnd = ( evFrom == wxJSONEVENT_ARRAY_END );
+        bool toEnd   = ( evTo == wxJSONEVENT_ARRAY_END );
+        if ( fromEnd && toEnd )  {
+            break;
+        }
+        wxString sub = wxString::Format( _T("%s/%d"), path.c_str(), index );
+        if ( toEnd )  {
+            m_from->Skip( evFrom );
+            AddOp( *m_patch, _T("remove"), sub, 0 );
+            evFrom = m_from->Next( fromVal );
+        }
+        else if ( fromEnd )  {
+            m_to->ReadTree( evTo, toVal );
+            AddOp( *m_patch, _T("add"), path + _T("/-"), &toVal );
+            evTo = m_to->Next( toVal );
+        }
+        else  {
+            DiffStream( sub, evFrom, fromVal, evTo, toVal );
+            ++index;
+            evFrom = m_from->Next( fromVal );
+            evTo   = m_to->Next( toVal );
+        }
+    }
+}
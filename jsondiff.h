@@ -0,0 +1,53 @@
+
+#if !defined( _WX_JSONDIFF_H )
+#define _WX_JSONDIFF_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+#include "jsonreader.h"
+
+#include <wx/stream.h>
+#include <wx/arrstr.h>
+
+class wxJSONEventReader;
+
+class WXDLLIMPEXP_JSON wxJSONDiff
+{
+public:
+    wxJSONDiff( int flags = wxJSONREADER_TOLERANT, int maxErrors = 30 );
+    ~wxJSONDiff();
+
+    int  Diff( wxInputStream& from, wxInputStream& to, wxJSONValue& patch );
+    static void DiffValues( const wxString& path, const wxJSONValue& from,
+                    const wxJSONValue& to, wxJSONValue& patch );
+    static wxString EscapeKey( const wxString& key );
+
+    void   SetMaxPending( size_t bytes );
+    size_t GetMaxPending() const;
+
+    const wxArrayString& GetErrors() const;
+    int  GetErrorCount() const;
+
+protected:
+    void DiffStream( const wxString& path, int evFrom, wxJSONValue& from,
+                    int evTo, wxJSONValue& to );
+    void DiffObjects( const wxString& path );
+    void DiffArrays( const wxString& path );
+    bool Failed();
+    void AddPending( wxJSONValue& pending, const wxString& key, const wxJSONValue& value );
+    void RemovePending( wxJSONValue& pending, const wxString& key );
+    static void AddOp( wxJSONValue& patch, const wxChar* op, const wxString& path,
+                    const wxJSONValue* value );
+
+    int                m_flags;
+    int                m_maxErrors;
+    wxJSONEventReader* m_from;
+    wxJSONEventReader* m_to;
+    wxJSONValue*       m_patch;
+    wxArrayString      m_errors;
+    bool               m_failed;
+    size_t             m_maxPending;
+    size_t             m_pendingBytes;
+};
+
+#endif // not defined _WX_JSONDIFF_H
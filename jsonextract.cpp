@@ -0,0 +1,185 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonextract.h"
+#include "jsontrace.h"
+
+#include <wx/buffer.h>
+#include <wx/debug.h>
+#include <string.h>
+
+
+/*! \class wxJSONLogExtractor
+ \brief Extract the JSON values embedded in the lines of a text log
+
+ Many application logs are text files whose lines contain a JSON object
+ or array somewhere in the middle, for example:
+
+ \code
+  2011-05-02 10:12:01 [INFO] request done {"id":42,"status":200,"ms":12}
+ \endcode
+
+ The wxJSONReader::Parse() functions can skip the text that precedes the
+ value but they do so reading one char at a time and they treat a slash
+ as the start of a comment, which is often wrong in log lines (paths,
+ URLs, dates).
+ This class scans every line with \b memchr for the first '{' or '['
+ character, parses the text from that character up to the end of the line
+ and, if it is a valid JSON value, passes it to a wxJSONExtractHandler
+ together with the line number and the byte offset of the value in the
+ line.
+ If the text at a candidate start character is not a valid value (for
+ example the \c [INFO] tag above), the next '{' or '[' of the same line is
+ tried. At most one value is extracted from every line.
+
+ The handler's wxJSONExtractHandler::OnValue() function returns FALSE to
+ stop the extraction.
+
+ The text is read as UTF-8; lines end with LF, and a CR that precedes the
+ LF is ignored.
+ The values are parsed by a wxJSONReader object constructed with the
+ \c flags and \c maxErrors parameters of the extractor's ctor; values that
+ cause errors are not reported.
+*/
+
+/*!
+ Construct an extractor.
+
+ \param flags the flags of the wxJSONReader used to parse the values
+ \param maxErrors the maximum number of errors of the wxJSONReader
+*/
+wxJSONLogExtractor::wxJSONLogExtractor( int flags, int maxErrors )
+    : m_reader( flags, maxErrors )
+{
+    m_handler   = 0;
+    m_lineNo    = 0;
+    m_numValues = 0;
+    m_stop      = false;
+}
+
+wxJSONLogExtractor::~wxJSONLogExtractor()
+{
+}
+
+/*!
+ The two overloaded versions of the \c Extract() function read a text log
+ stored in a memory buffer or in a wxInputStream object and pass every
+ JSON value found in the log to \c handler.
+ Line numbers start at 1.
+
+ Returns the number of values passed to the handler.
+*/
+int
+wxJSONLogExtractor::Extract( const char* buff, size_t len, wxJSONExtractHandler& handler )
+{
+    m_handler   = &handler;
+    m_lineNo    = 0;
+    m_numValues = 0;
+    m_stop      = false;
+
+    ExtractLines( buff, buff + len, true );
+
+    m_handler = 0;
+    return m_numValues;
+}
+
+int
+wxJSONLogExtractor::Extract( wxInputStream& is, wxJSONExtractHandler& handler )
+{
+    static const size_t chunkSize = 256 * 1024;
+
+    m_handler   = &handler;
+    m_lineNo    = 0;
+    m_numValues = 0;
+    m_stop      = false;
+
+    // 'buff' holds the incomplete last line of the previous chunk
+    // followed by the new chunk
+    wxMemoryBuffer buff;
+    while ( !m_stop && !is.Eof() )  {
+        size_t len = buff.GetDataLen();
+        char* data = (char*) buff.GetWriteBuf( len + chunkSize );
+        is.Read( data + len, chunkSize );
+        size_t numRead = is.LastRead();
+        buff.UngetWriteBuf( len + numRead );
+        if ( numRead == 0 )  {
+            break;
+        }
+        wxJSON_PROBE2( buffer__refill, (long long) is.TellI(), (long) ( len + numRead ));
+
+        const char* end  = data + len + numRead;
+        const char* rest = ExtractLines( data, end, false );
+        size_t restLen = end - rest;
+        memmove( data, rest, restLen );
+        buff.SetDataLen( restLen );
+    }
+    if ( !m_stop && buff.GetDataLen() > 0 )  {
+        const char* data = (const char*) buff.GetData();
+        ExtractLines( data, data + buff.GetDataLen(), true );
+    }
+
+    m_handler = 0;
+    return m_numValues;
+}
+
+/*!
+ The function processes the lines in the range [\c buff, \c end).
+ If \c last is FALSE, the text after the last LF is an incomplete line: it
+ is not processed and a pointer to it is returned.
+ Otherwise the text after the last LF is processed as the last line and
+ \c end is returned.
+*/
+const char*
+wxJSONLogExtractor::ExtractLines( const char* buff, const char* end, bool last )
+{
+    const char* line = buff;
+    while ( line < end && !m_stop )  {
+        const char* lf = (const char*) memchr( line, '\n', end - line );
+        if ( lf == 0 && !last )  {
+            return line;
+        }
+        const char* lineEnd = lf != 0 ? lf : end;
+        ++m_lineNo;
+        if ( lineEnd > line && lineEnd[-1] == '\r' )  {
+            ExtractLine( line, lineEnd - 1 );
+        }
+        else  {
+            ExtractLine( line, lineEnd );
+        }
+        line = lf != 0 ? lf + 1 : end;
+    }
+    return end;
+}
+
+/*!
+ The function searches the first valid JSON value in the line [\c line, \c end)
+ and passes it to the handler.
+ Returns TRUE if a value was found.
+*/
+bool
+wxJSONLogExtractor::ExtractLine( const char* line, const char* end )
+{
+    const char* p = line;
+    while ( p < end )  {
+        const char* object = (const char*) memchr( p, '{', end - p );
+        const char* array  = (const char*) memchr( p, '[', ( object != 0 ? object : end ) - p );
+        const char* start  = array != 0 ? array : object;
+        if ( start == 0 )  {
+            break;
+        }
+
+        wxJSONValue value;
+        if ( m_reader.Parse( start, end - start, &value ) == 0 )  {
+            ++m_numValues;
+            if ( !m_handler->OnValue( m_lineNo, start - line, value ))  {
+                m_stop = true;
+            }
+            return true;
+        }
+        p = start + 1;
+    }
+    return false;
+}
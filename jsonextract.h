@@ -0,0 +1,39 @@
+
+#if !defined( _WX_JSONEXTRACT_H )
+#define _WX_JSONEXTRACT_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+#include "jsonreader.h"
+
+#include <wx/stream.h>
+
+class WXDLLIMPEXP_JSON wxJSONExtractHandler
+{
+public:
+    virtual ~wxJSONExtractHandler() {}
+
+    virtual bool OnValue( int lineNo, size_t offset, wxJSONValue& value ) = 0;
+};
+
+class WXDLLIMPEXP_JSON wxJSONLogExtractor
+{
+public:
+    wxJSONLogExtractor( int flags = wxJSONREADER_STRICT, int maxErrors = 30 );
+    ~wxJSONLogExtractor();
+
+    int  Extract( const char* buff, size_t len, wxJSONExtractHandler& handler );
+    int  Extract( wxInputStream& is, wxJSONExtractHandler& handler );
+
+protected:
+    const char* ExtractLines( const char* buff, const char* end, bool last );
+    bool ExtractLine( const char* line, const char* end );
+
+    wxJSONReader          m_reader;
+    wxJSONExtractHandler* m_handler;
+    int                   m_lineNo;
+    int                   m_numValues;
+    bool                  m_stop;
+};
+
+#endif // not defined _WX_JSONEXTRACT_H
@@ -0,0 +1,187 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonfootprint.h"
+
+#include <wx/hashset.h>
+#include <wx/debug.h>
+
+
+/*! \class wxJSONFootprint
+ \brief Compute the memory used by a tree of JSON values
+
+ Caches of parsed documents are usually sized by the memory that the
+ documents use; this class returns the number of bytes that are allocated
+ on the heap for a wxJSONValue (or a wxJSONSortedObject) and all the
+ values that it contains:
+
+ \li the shared data structure of every value (wxJSONRefData)
+ \li the characters of string values and of member names
+ \li the slots of arrays (their allocated capacity, not only the used ones)
+ \li the nodes and buckets of objects' hash maps
+ \li the member array, the key buffer and the prefix table of a
+     wxJSONSortedObject
+ \li the comment lines stored in the values
+ \li the data of memory buffers
+
+ The result is an \b approximation: wxHashMap does not tell how many
+ buckets it allocated, so one bucket per member is assumed (the real
+ number is between one and two per member, depending on when the table
+ was last grown); the bytes are those requested to the allocator, whose
+ own overhead (usually 8 or 16 bytes for every block) is not included.
+ The data that is shared by two or more values (because of the
+ copy-on-write mechanism) is counted only once.
+ C-string values (see wxJSONValue::IsCString()) do not own their
+ characters, which are not counted.
+
+ Count() walks the whole tree and it can be used at any time, for example
+ after the tree was modified; wxJSONReader can also compute the footprint
+ of the tree that it builds while it reads the JSON text (see the
+ \c wxJSONREADER_FOOTPRINT flag and wxJSONReader::GetFootprint()), at no
+ extra cost.
+
+ \par Example:
+
+ \code
+  wxJSONReader reader( wxJSONREADER_STRICT | wxJSONREADER_FOOTPRINT );
+  wxJSONValue  doc;
+  reader.Parse( jsonText, &doc );
+  cache.Add( url, doc, reader.GetFootprint() );
+
+  ...
+  doc[_T("visits")].Append( visit );
+  cache.Resize( url, wxJSONFootprint::Count( doc ));
+ \endcode
+*/
+
+WX_DECLARE_HASH_SET( const void*, wxPointerHash, wxPointerEqual, wxJSONRefDataSet );
+
+// the number of bytes of the characters of a string, including the NUL
+size_t
+wxJSONFootprint::StringBytes( const wxString& s )
+{
+    return ( s.capacity() + 1 ) * sizeof( wxChar );
+}
+
+/*!
+ Return the bytes of the value's own data: the shared data structure,
+ the characters of a string, the allocated slots of an array or the
+ (estimated) buckets of an object and the data of a memory buffer.
+ The array's items, the object's members and the comment lines are not
+ included.
+*/
+size_t
+wxJSONFootprint::NodeBytes( const wxJSONValue& value )
+{
+    if ( value.GetRefData() == 0 )  {
+        return 0;
+    }
+
+    size_t bytes = sizeof( wxJSONRefData );
+    switch ( value.GetType() )  {
+        case wxJSONTYPE_STRING :
+            bytes += StringBytes( value.AsString() );
+            break;
+        case wxJSONTYPE_MEMORYBUFF :
+            bytes += sizeof( wxMemoryBuffer ) + value.AsMemoryBuff().GetBufSize();
+            break;
+        case wxJSONTYPE_ARRAY :
+            bytes += value.AsArray()->capacity() * sizeof( void* );
+            break;
+        case wxJSONTYPE_OBJECT :
+            // the buckets: the hash map keeps the load factor below 1 but
+            // does not tell the size of its table
+            bytes += value.AsMap()->size() * sizeof( void* );
+            break;
+        default :
+            break;
+    }
+    return bytes;
+}
+
+//! Return the bytes of an array's item, excluding the item's own data
+size_t
+wxJSONFootprint::ItemBytes()
+{
+    return sizeof( wxJSONValue );
+}
+
+//! Return the bytes of an object's member, excluding the member's own data
+size_t
+wxJSONFootprint::MemberBytes( const wxString& key )
+{
+    // the hash map node: the next pointer, the key and the value
+    return sizeof( void* ) + sizeof( wxString ) + sizeof( wxJSONValue )
+        + StringBytes( key );
+}
+
+//! Return the bytes of a comment line stored in a value
+size_t
+wxJSONFootprint::CommentBytes( const wxString& comment )
+{
+    return sizeof( wxString ) + StringBytes( comment );
+}
+
+static size_t
+CountValue( const wxJSONValue& value, wxJSONRefDataSet& shared )
+{
+    const wxJSONRefData* data = value.GetRefData();
+    if ( data == 0 )  {
+        return 0;
+    }
+    if ( data->GetRefCount() > 1 && !shared.insert( data ).second )  {
+        // already counted
+        return 0;
+    }
+
+    size_t bytes = wxJSONFootprint::NodeBytes( value );
+    const wxArrayString& comments = value.GetCommentArray();
+    for ( size_t i = 0; i < comments.GetCount(); i++ )  {
+        bytes += wxJSONFootprint::CommentBytes( comments[i] );
+    }
+    if ( value.IsArray() )  {
+        const wxJSONInternalArray* arr = value.AsArray();
+        for ( size_t i = 0; i < arr->GetCount(); i++ )  {
+            bytes += wxJSONFootprint::ItemBytes() + CountValue( arr->Item( i ), shared );
+        }
+    }
+    else if ( value.IsObject() )  {
+        const wxJSONInternalMap* map = value.AsMap();
+        wxJSONInternalMap::const_iterator it;
+        for ( it = map->begin(); it != map->end(); ++it )  {
+            bytes += wxJSONFootprint::MemberBytes( it->first ) + CountValue( it->second, shared );
+        }
+    }
+    return bytes;
+}
+
+/*!
+ Return the number of bytes allocated for \c value and all the values
+ that it contains.
+ The function walks the whole tree once and does not allocate memory
+ except for the values that are shared by two or more parents.
+*/
+size_t
+wxJSONFootprint::Count( const wxJSONValue& value )
+{
+    wxJSONRefDataSet shared;
+    return CountValue( value, shared );
+}
+
+/*!
+ Return the number of bytes allocated for the sorted object \c obj (see
+ wxJSONSortedObject::GetOwnBytes()) and all the values of its members.
+*/
+size_t
+wxJSONFootprint::Count( const wxJSONSortedObject& obj )
+{
+    wxJSONRefDataSet shared;
+    size_t bytes = obj.GetOwnBytes();
+    for ( size_t i = 0; i < obj.GetCount(); i++ )  {
+        bytes += CountValue( obj.GetValue( i ), shared );
+    }
+    return bytes;
+}
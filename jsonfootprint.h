@@ -0,0 +1,25 @@
+
+#if !defined( _WX_JSONFOOTPRINT_H )
+#define _WX_JSONFOOTPRINT_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+#include "jsonsorted.h"
+
+#include <wx/string.h>
+
+class WXDLLIMPEXP_JSON wxJSONFootprint
+{
+public:
+    static size_t Count( const wxJSONValue& value );
+    static size_t Count( const wxJSONSortedObject& obj );
+
+    // the parts of the footprint, also used by wxJSONReader
+    static size_t NodeBytes( const wxJSONValue& value );
+    static size_t ItemBytes();
+    static size_t MemberBytes( const wxString& key );
+    static size_t CommentBytes( const wxString& comment );
+    static size_t StringBytes( const wxString& s );
+};
+
+#endif // not defined _WX_JSONFOOTPRINT_H
@@ -0,0 +1,827 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonimage.h"
+
+#include <wx/dynarray.h>
+#include <wx/debug.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined( __UNIX__ )
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+/*! \class wxJSONImage
+ \brief A read-only JSON document stored in a position-independent memory image
+
+ A JSON text that is read by several processes normally has to be parsed
+ by each of them, and each process holds its own wxJSONValue tree.
+ This class allows a process to convert the tree to a flat memory
+ \e image (see Build()) that is written to a file or to a shared memory
+ segment once; the other processes map the image read-only and navigate
+ it directly through wxJSONImageValue objects, without parsing and without
+ building a tree.
+
+ The image contains no pointers: all references are 32-bit offsets from
+ the start of the image so that it can be mapped at any address.
+ Its layout is:
+
+ \li a 16-byte header: the magic \c "wxJI", the format version (16 bits),
+    the byte order mark 0x0102 (16 bits, native order), the offset of the
+    root node and the size of the image (32 bits each)
+ \li the nodes: every node starts, on a 4-byte boundary, with two 32-bit
+    words: the node type and a count; the payload follows:
+    - null, bool: no payload, the count holds the boolean value
+    - integers and doubles: 8 bytes, 8-byte aligned
+    - strings and memory buffers: the count is the length in bytes; the
+      bytes follow (UTF-8 for strings) plus a NUL terminator
+    - arrays: the count is the number of elements; the offsets of the
+      element nodes follow
+    - objects: the count is the number of members; a (name offset, value
+      offset) pair follows for every member, sorted by the UTF-8 bytes of
+      the name so that members are found by binary search
+
+ Images are limited to 4 GBytes and they can only be read on machines
+ with the same byte order as the one that built them.
+
+ \par Example:
+
+ \code
+  // loader process
+  wxJSONReader   reader;
+  wxMemoryBuffer image;
+  wxFileInputStream jsonText( _T("config.json") );
+  reader.ParseToImage( jsonText, image );
+  wxFile file( _T("/dev/shm/config.jsi"), wxFile::write );
+  file.Write( image.GetData(), image.GetDataLen() );
+
+  // worker processes
+  wxJSONImage doc;
+  if ( doc.MapFile( _T("/dev/shm/config.jsi") ))  {
+    wxJSONImageValue timeout = doc.GetRoot()[_T("server")][_T("timeout")];
+    if ( timeout.IsInt() )  {
+      ...
+    }
+  }
+ \endcode
+*/
+
+static const char     s_imageMagic[4] = { 'w', 'x', 'J', 'I' };
+static const wxUint16 s_imageVersion  = 1;
+static const wxUint16 s_imageByteOrder = 0x0102;
+static const size_t   s_headerLen     = 16;
+
+/*!
+ \struct wxJSONImageMember
+ \brief A member of an object being written to an image
+*/
+struct wxJSONImageMember
+{
+    wxCharBuffer key;
+    size_t       keyLen;
+    wxUint32     keyOffset;
+    wxUint32     valueOffset;
+};
+
+WX_DEFINE_ARRAY_PTR( wxJSONImageMember*, wxJSONImageMemberArray );
+
+static int
+CompareKeys( const char* k1, size_t len1, const char* k2, size_t len2 )
+{
+    int r = memcmp( k1, k2, len1 < len2 ? len1 : len2 );
+    if ( r == 0 && len1 != len2 )  {
+        r = len1 < len2 ? -1 : 1;
+    }
+    return r;
+}
+
+static int
+CompareImageMembers( wxJSONImageMember** first, wxJSONImageMember** second )
+{
+    return CompareKeys( (*first)->key.data(), (*first)->keyLen,
+                (*second)->key.data(), (*second)->keyLen );
+}
+
+
+wxJSONImage::wxJSONImage()
+{
+    m_data    = 0;
+    m_size    = 0;
+    m_mapped  = 0;
+    m_mapSize = 0;
+}
+
+//! Construct an image object that reads the image stored in \c data
+wxJSONImage::wxJSONImage( const void* data, size_t size )
+{
+    m_data    = 0;
+    m_size    = 0;
+    m_mapped  = 0;
+    m_mapSize = 0;
+    Attach( data, size );
+}
+
+wxJSONImage::~wxJSONImage()
+{
+    Close();
+}
+
+/*!
+ Read the image stored in \c data, which must outlive this object.
+ The nodes are read through 32-bit words so \c data must be aligned on
+ a 4-byte boundary, as the memory returned by \c malloc() or \c mmap()
+ is.
+ Returns FALSE if \c data is not aligned or does not contain a valid
+ image.
+*/
+bool
+wxJSONImage::Attach( const void* data, size_t size )
+{
+    Close();
+
+    const char* p = (const char*) data;
+    if ( p == 0 || (wxUIntPtr) p % 4 != 0 || size < s_headerLen ||
+         memcmp( p, s_imageMagic, 4 ) != 0 )  {
+        return false;
+    }
+    wxUint16 version, byteOrder;
+    wxUint32 imageSize;
+    memcpy( &version, p + 4, 2 );
+    memcpy( &byteOrder, p + 6, 2 );
+    memcpy( &imageSize, p + 12, 4 );
+    if ( version != s_imageVersion || byteOrder != s_imageByteOrder ||
+         imageSize < s_headerLen || imageSize > size )  {
+        return false;
+    }
+    m_data = p;
+    m_size = imageSize;
+    return true;
+}
+
+/*!
+ Map the image stored in the file \c fileName read-only in the address
+ space of the process.
+ The file can be a regular file or a shared memory object (for example
+ in \c /dev/shm); all the processes that map it share the same physical
+ pages.
+ This function is only available on Unix-like systems; on other systems
+ it always returns FALSE.
+*/
+bool
+wxJSONImage::MapFile( const wxString& fileName )
+{
+    Close();
+#if defined( __UNIX__ )
+    int fd = open( fileName.fn_str(), O_RDONLY );
+    if ( fd < 0 )  {
+        return false;
+    }
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if ( fstat( fd, &st ) == 0 && st.st_size > 0 )  {
+        addr = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    close( fd );
+    if ( addr == MAP_FAILED )  {
+        return false;
+    }
+    if ( !Attach( addr, st.st_size ))  {
+        munmap( addr, st.st_size );
+        return false;
+    }
+    // m_size is the size of the image, set by Attach()
+    m_mapped  = addr;
+    m_mapSize = st.st_size;
+    return true;
+#else
+    wxUnusedVar( fileName );
+    return false;
+#endif
+}
+
+//! Detach the image and unmap it if it was mapped by MapFile()
+void
+wxJSONImage::Close()
+{
+#if defined( __UNIX__ )
+    if ( m_mapped != 0 )  {
+        munmap( m_mapped, m_mapSize );
+    }
+#endif
+    m_mapped  = 0;
+    m_mapSize = 0;
+    m_data    = 0;
+    m_size    = 0;
+}
+
+//! Return TRUE if the object reads a valid image
+bool
+wxJSONImage::IsOk() const
+{
+    return m_data != 0;
+}
+
+//! Return the root value of the document
+wxJSONImageValue
+wxJSONImage::GetRoot() const
+{
+    if ( m_data == 0 )  {
+        return wxJSONImageValue();
+    }
+    wxUint32 root;
+    memcpy( &root, m_data + 8, 4 );
+    return wxJSONImageValue( m_data, m_size, root );
+}
+
+/*!
+ The function converts the \c root value to an image and stores it in
+ \c image, replacing its old content.
+ The image can be copied anywhere: to a file, to a shared memory segment
+ or to another process.
+ Returns FALSE if the image would be larger than 4 GBytes.
+*/
+bool
+wxJSONImage::Build( const wxJSONValue& root, wxMemoryBuffer& image )
+{
+    image.SetDataLen( 0 );
+    char header[s_headerLen];
+    memset( header, 0, s_headerLen );
+    image.AppendData( header, s_headerLen );
+
+    wxUint32 rootOffset = BuildNode( root, image );
+    size_t size = image.GetDataLen();
+    if ( size > 0xFFFFFFFFu )  {
+        image.SetDataLen( 0 );
+        return false;
+    }
+
+    wxUint32 imageSize = (wxUint32) size;
+    char* p = (char*) image.GetData();
+    memcpy( p, s_imageMagic, 4 );
+    memcpy( p + 4, &s_imageVersion, 2 );
+    memcpy( p + 6, &s_imageByteOrder, 2 );
+    memcpy( p + 8, &rootOffset, 4 );
+    memcpy( p + 12, &imageSize, 4 );
+    return true;
+}
+
+// append a node to the image and return its offset
+wxUint32
+wxJSONImage::AppendNode( wxMemoryBuffer& image, int type, wxUint32 count,
+                    const void* payload, size_t payloadLen, size_t align )
+{
+    static const char zeroes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    size_t pad = ( align - image.GetDataLen() % align ) % align;
+    image.AppendData( zeroes, pad );
+
+    wxUint32 offset = (wxUint32) image.GetDataLen();
+    wxUint32 words[2] = { (wxUint32) type, count };
+    image.AppendData( words, sizeof( words ));
+    if ( payloadLen > 0 )  {
+        image.AppendData( payload, payloadLen );
+    }
+    return offset;
+}
+
+// append a string or memory buffer node, with its NUL terminator
+wxUint32
+wxJSONImage::BuildString( const char* data, size_t len, int type, wxMemoryBuffer& image )
+{
+    wxUint32 offset = AppendNode( image, type, (wxUint32) len, data, len, 4 );
+    image.AppendByte( 0 );
+    return offset;
+}
+
+// append the nodes of 'val' and of all its children; return the offset of 'val'
+wxUint32
+wxJSONImage::BuildNode( const wxJSONValue& val, wxMemoryBuffer& image )
+{
+    switch ( val.GetType() )  {
+        case wxJSONTYPE_NULL :
+            return AppendNode( image, wxJSONIMAGE_NULL, 0, 0, 0, 4 );
+
+        case wxJSONTYPE_BOOL :
+            return AppendNode( image, wxJSONIMAGE_BOOL, val.AsBool() ? 1 : 0, 0, 0, 4 );
+
+        case wxJSONTYPE_INT :
+        case wxJSONTYPE_SHORT :
+        case wxJSONTYPE_LONG :
+        case wxJSONTYPE_INT64 :  {
+#if defined( wxJSON_64BIT_INT )
+            wxInt64 i = val.AsInt64();
+#else
+            wxInt64 i = val.AsLong();
+#endif
+            return AppendNode( image, wxJSONIMAGE_INT, 0, &i, 8, 8 );
+        }
+
+        case wxJSONTYPE_UINT :
+        case wxJSONTYPE_USHORT :
+        case wxJSONTYPE_ULONG :
+        case wxJSONTYPE_UINT64 :  {
+#if defined( wxJSON_64BIT_INT )
+            wxUint64 ui = val.AsUInt64();
+#else
+            wxUint64 ui = val.AsULong();
+#endif
+            return AppendNode( image, wxJSONIMAGE_UINT, 0, &ui, 8, 8 );
+        }
+
+        case wxJSONTYPE_DOUBLE :  {
+            double d = val.AsDouble();
+            return AppendNode( image, wxJSONIMAGE_DOUBLE, 0, &d, 8, 8 );
+        }
+
+        case wxJSONTYPE_STRING :
+        case wxJSONTYPE_CSTRING :  {
+            wxCharBuffer utf8 = val.AsString().ToUTF8();
+            return BuildString( utf8.data(), utf8.length(), wxJSONIMAGE_STRING, image );
+        }
+
+        case wxJSONTYPE_MEMORYBUFF :  {
+            wxMemoryBuffer buff = val.AsMemoryBuff();
+            return BuildString( (const char*) buff.GetData(), buff.GetDataLen(),
+                            wxJSONIMAGE_MEMORYBUFF, image );
+        }
+
+        case wxJSONTYPE_ARRAY :  {
+            int size = val.Size();
+            wxMemoryBuffer offsets;
+            for ( int i = 0; i < size; i++ )  {
+                wxUint32 offset = BuildNode( val.ItemAt( i ), image );
+                offsets.AppendData( &offset, sizeof( offset ));
+            }
+            return AppendNode( image, wxJSONIMAGE_ARRAY, size,
+                        offsets.GetData(), offsets.GetDataLen(), 4 );
+        }
+
+        case wxJSONTYPE_OBJECT :  {
+            wxArrayString names = val.GetMemberNames();
+            wxJSONImageMemberArray members;
+            for ( size_t i = 0; i < names.GetCount(); i++ )  {
+                wxJSONImageMember* member = new wxJSONImageMember;
+                member->key = names[i].ToUTF8();
+                member->keyLen = member->key.length();
+                member->keyOffset = BuildString( member->key.data(), member->keyLen,
+                                        wxJSONIMAGE_STRING, image );
+                member->valueOffset = BuildNode( val.ItemAt( names[i] ), image );
+                members.Add( member );
+            }
+            members.Sort( CompareImageMembers );
+
+            wxMemoryBuffer pairs;
+            for ( size_t i = 0; i < members.GetCount(); i++ )  {
+                pairs.AppendData( &members[i]->keyOffset, sizeof( wxUint32 ));
+                pairs.AppendData( &members[i]->valueOffset, sizeof( wxUint32 ));
+                delete members[i];
+            }
+            return AppendNode( image, wxJSONIMAGE_OBJECT, members.GetCount(),
+                        pairs.GetData(), pairs.GetDataLen(), 4 );
+        }
+
+        default :
+            return AppendNode( image, wxJSONIMAGE_INVALID, 0, 0, 0, 4 );
+    }
+}
+
+
+/*! \class wxJSONImageValue
+ \brief A value stored in a wxJSONImage
+
+ Objects of this class are small handles (the address of the image and
+ an offset) that are returned by wxJSONImage::GetRoot() and by the
+ navigation functions; they can be freely copied.
+ The functions never read outside of the image: a handle that refers to
+ a missing item or to a damaged node is \e invalid and all the access
+ functions return empty values.
+ wxJSONImage::Build() writes the children of a node before the node, so
+ the navigation functions only return children stored at a lower offset
+ than their parent: a damaged image cannot make ToValue() loop forever.
+ The function names follow those of wxJSONValue; ToValue() converts the
+ value and all its children to a wxJSONValue.
+*/
+
+wxJSONImageValue::wxJSONImageValue()
+{
+    m_base   = 0;
+    m_size   = 0;
+    m_offset = 0;
+}
+
+wxJSONImageValue::wxJSONImageValue( const char* base, size_t size, wxUint32 offset )
+{
+    m_base   = base;
+    m_size   = size;
+    m_offset = offset;
+}
+
+// the two header words of the node or NULL if the node is out of the image
+const wxUint32*
+wxJSONImageValue::Node() const
+{
+    if ( m_base == 0 || m_offset % 4 != 0 || (size_t) m_offset + 8 > m_size )  {
+        return 0;
+    }
+    return (const wxUint32*) ( m_base + m_offset );
+}
+
+// the payload of the node or NULL if it does not fit in the image
+const wxUint32*
+wxJSONImageValue::Payload( size_t bytes ) const
+{
+    if ( Node() == 0 || bytes > m_size - m_offset - 8 )  {
+        return 0;
+    }
+    return (const wxUint32*) ( m_base + m_offset + 8 );
+}
+
+// the child slots of an array (one word each) or of an object (two words
+// each) and their number or NULL if they do not fit in the image
+const wxUint32*
+wxJSONImageValue::Slots( size_t* count ) const
+{
+    const wxUint32* node = Node();
+    if ( node == 0 || ( node[0] != wxJSONIMAGE_ARRAY && node[0] != wxJSONIMAGE_OBJECT ))  {
+        return 0;
+    }
+    size_t width = node[0] == wxJSONIMAGE_ARRAY ? 4 : 8;
+    size_t n = node[1];
+    if ( n > INT_MAX || n > ( m_size - m_offset - 8 ) / width )  {
+        return 0;
+    }
+    *count = n;
+    return node + 2;
+}
+
+// the child stored at 'offset' or an invalid value if it is not stored
+// before this node
+wxJSONImageValue
+wxJSONImageValue::Child( wxUint32 offset ) const
+{
+    if ( offset >= m_offset )  {
+        return wxJSONImageValue();
+    }
+    return wxJSONImageValue( m_base, m_size, offset );
+}
+
+int
+wxJSONImageValue::GetType() const
+{
+    const wxUint32* node = Node();
+    return node != 0 ? (int) node[0] : wxJSONIMAGE_INVALID;
+}
+
+bool
+wxJSONImageValue::IsValid() const
+{
+    return GetType() != wxJSONIMAGE_INVALID;
+}
+
+bool
+wxJSONImageValue::IsNull() const
+{
+    return GetType() == wxJSONIMAGE_NULL;
+}
+
+bool
+wxJSONImageValue::IsBool() const
+{
+    return GetType() == wxJSONIMAGE_BOOL;
+}
+
+bool
+wxJSONImageValue::IsInt() const
+{
+    return GetType() == wxJSONIMAGE_INT;
+}
+
+bool
+wxJSONImageValue::IsUInt() const
+{
+    return GetType() == wxJSONIMAGE_UINT;
+}
+
+bool
+wxJSONImageValue::IsDouble() const
+{
+    return GetType() == wxJSONIMAGE_DOUBLE;
+}
+
+bool
+wxJSONImageValue::IsString() const
+{
+    return GetType() == wxJSONIMAGE_STRING;
+}
+
+bool
+wxJSONImageValue::IsMemoryBuff() const
+{
+    return GetType() == wxJSONIMAGE_MEMORYBUFF;
+}
+
+bool
+wxJSONImageValue::IsArray() const
+{
+    return GetType() == wxJSONIMAGE_ARRAY;
+}
+
+bool
+wxJSONImageValue::IsObject() const
+{
+    return GetType() == wxJSONIMAGE_OBJECT;
+}
+
+bool
+wxJSONImageValue::AsBool() const
+{
+    return IsBool() && Node()[1] != 0;
+}
+
+// the payload of a numeric node
+union wxJSONImageNumber
+{
+    wxInt64  i;
+    wxUint64 u;
+    double   d;
+};
+
+// copies the 8-byte payload of a numeric node to 'n' and returns the
+// type of the node or wxJSONIMAGE_INVALID if the payload is missing.
+// The image is only 4-byte aligned (see wxJSONImage::Attach()) so the
+// payload is copied instead of being read through a 64-bit pointer.
+int
+wxJSONImageValue::ReadNumber( wxJSONImageNumber* n ) const
+{
+    int type = GetType();
+    if ( type != wxJSONIMAGE_INT && type != wxJSONIMAGE_UINT && type != wxJSONIMAGE_DOUBLE )  {
+        return wxJSONIMAGE_INVALID;
+    }
+    const wxUint32* p = Payload( 8 );
+    if ( p == 0 )  {
+        return wxJSONIMAGE_INVALID;
+    }
+    memcpy( n, p, 8 );
+    return type;
+}
+
+//! Return the value of an integer or double value converted to wxInt64
+wxInt64
+wxJSONImageValue::AsInt64() const
+{
+    wxJSONImageNumber n;
+    switch ( ReadNumber( &n ))  {
+        case wxJSONIMAGE_INT :
+            return n.i;
+        case wxJSONIMAGE_UINT :
+            return (wxInt64) n.u;
+        case wxJSONIMAGE_DOUBLE :
+            return (wxInt64) n.d;
+        default :
+            return 0;
+    }
+}
+
+//! Return the value of an integer or double value converted to wxUint64
+wxUint64
+wxJSONImageValue::AsUInt64() const
+{
+    wxJSONImageNumber n;
+    switch ( ReadNumber( &n ))  {
+        case wxJSONIMAGE_INT :
+            return (wxUint64) n.i;
+        case wxJSONIMAGE_UINT :
+            return n.u;
+        case wxJSONIMAGE_DOUBLE :
+            return (wxUint64) n.d;
+        default :
+            return 0;
+    }
+}
+
+//! Return the value of an integer or double value converted to double
+double
+wxJSONImageValue::AsDouble() const
+{
+    wxJSONImageNumber n;
+    switch ( ReadNumber( &n ))  {
+        case wxJSONIMAGE_INT :
+            return (double) n.i;
+        case wxJSONIMAGE_UINT :
+            return (double) n.u;
+        case wxJSONIMAGE_DOUBLE :
+            return n.d;
+        default :
+            return 0;
+    }
+}
+
+/*!
+ Return a pointer to the NUL-terminated UTF-8 text of a string value,
+ stored in the image, and optionally its length in bytes.
+ Returns NULL if the value is not a string.
+*/
+const char*
+wxJSONImageValue::AsUTF8( size_t* len ) const
+{
+    if ( !IsString() )  {
+        return 0;
+    }
+    size_t numBytes = Node()[1];
+    if ( numBytes >= m_size )  {
+        return 0;
+    }
+    const wxUint32* p = Payload( numBytes + 1 );
+    if ( p == 0 )  {
+        return 0;
+    }
+    if ( len != 0 )  {
+        *len = numBytes;
+    }
+    return (const char*) p;
+}
+
+//! Return the string value or, for the other types, their text representation
+wxString
+wxJSONImageValue::AsString() const
+{
+    size_t len;
+    const char* utf8 = AsUTF8( &len );
+    if ( utf8 != 0 )  {
+        return wxString::FromUTF8( utf8, len );
+    }
+    return ToValue().AsString();
+}
+
+/*!
+ Return a pointer to the data of a memory buffer value, stored in the
+ image, and its length in bytes.
+ Returns NULL if the value is not a memory buffer.
+*/
+const void*
+wxJSONImageValue::AsMemoryBuff( size_t* len ) const
+{
+    if ( !IsMemoryBuff() )  {
+        return 0;
+    }
+    size_t numBytes = Node()[1];
+    const wxUint32* p = Payload( numBytes );
+    if ( p != 0 && len != 0 )  {
+        *len = numBytes;
+    }
+    return p;
+}
+
+//! Return the number of elements of an array or members of an object, -1 otherwise
+int
+wxJSONImageValue::Size() const
+{
+    size_t count;
+    return Slots( &count ) != 0 ? (int) count : -1;
+}
+
+/*!
+ Return the element at \c index of an array or the value of the member
+ at \c index of an object (in the order of the members' names).
+*/
+wxJSONImageValue
+wxJSONImageValue::ItemAt( int index ) const
+{
+    size_t count;
+    const wxUint32* p = Slots( &count );
+    if ( p == 0 || index < 0 || (size_t) index >= count )  {
+        return wxJSONImageValue();
+    }
+    if ( IsArray() )  {
+        return Child( p[index] );
+    }
+    return Child( p[(size_t) index * 2 + 1] );
+}
+
+//! Return the name of the member at \c index of an object
+wxString
+wxJSONImageValue::GetKeyAt( int index ) const
+{
+    size_t count;
+    const wxUint32* p = Slots( &count );
+    if ( p == 0 || !IsObject() || index < 0 || (size_t) index >= count )  {
+        return wxEmptyString;
+    }
+    return Child( p[(size_t) index * 2] ).AsString();
+}
+
+/*!
+ Return the value of the member \c key of an object.
+ The members are sorted by name so the function uses a binary search.
+*/
+wxJSONImageValue
+wxJSONImageValue::Find( const wxString& key ) const
+{
+    size_t count;
+    const wxUint32* pairs = Slots( &count );
+    if ( pairs == 0 || !IsObject() || count == 0 )  {
+        return wxJSONImageValue();
+    }
+
+    wxCharBuffer utf8 = key.ToUTF8();
+    size_t lo = 0, hi = count;
+    while ( lo < hi )  {
+        size_t mid = lo + ( hi - lo ) / 2;
+        size_t len;
+        const char* name = Child( pairs[mid * 2] ).AsUTF8( &len );
+        if ( name == 0 )  {
+            break;
+        }
+        int r = CompareKeys( name, len, utf8.data(), utf8.length() );
+        if ( r == 0 )  {
+            return Child( pairs[mid * 2 + 1] );
+        }
+        if ( r < 0 )  {
+            lo = mid + 1;
+        }
+        else  {
+            hi = mid;
+        }
+    }
+    return wxJSONImageValue();
+}
+
+wxJSONImageValue
+wxJSONImageValue::operator [] ( const wxString& key ) const
+{
+    return Find( key );
+}
+
+wxJSONImageValue
+wxJSONImageValue::operator [] ( int index ) const
+{
+    return ItemAt( index );
+}
+
+//! Convert the value and all its children to a wxJSONValue
+wxJSONValue
+wxJSONImageValue::ToValue() const
+{
+    wxJSONValue val;
+    switch ( GetType() )  {
+        case wxJSONIMAGE_NULL :
+            val.SetType( wxJSONTYPE_NULL );
+            break;
+        case wxJSONIMAGE_BOOL :
+            val = AsBool();
+            break;
+        case wxJSONIMAGE_INT :
+#if defined( wxJSON_64BIT_INT )
+            val = AsInt64();
+#else
+            val = (long) AsInt64();
+#endif
+            break;
+        case wxJSONIMAGE_UINT :
+#if defined( wxJSON_64BIT_INT )
+            val = AsUInt64();
+#else
+            val = (unsigned long) AsUInt64();
+#endif
+            break;
+        case wxJSONIMAGE_DOUBLE :
+            val = AsDouble();
+            break;
+        case wxJSONIMAGE_STRING :
+            val = AsString();
+            break;
+        case wxJSONIMAGE_MEMORYBUFF :  {
+            size_t len = 0;
+            const void* data = AsMemoryBuff( &len );
+            wxMemoryBuffer buff;
+            if ( data != 0 )  {
+                buff.AppendData( data, len );
+            }
+            val = buff;
+            break;
+        }
+        case wxJSONIMAGE_ARRAY :
+            val.SetType( wxJSONTYPE_ARRAY );
+            for ( int i = 0; i < Size(); i++ )  {
+                val.Append( ItemAt( i ).ToValue() );
+            }
+            break;
+        case wxJSONIMAGE_OBJECT :
+            val.SetType( wxJSONTYPE_OBJECT );
+            for ( int i = 0; i < Size(); i++ )  {
+                val[GetKeyAt( i )] = ItemAt( i ).ToValue();
+            }
+            break;
+        default :
+            break;
+    }
+    return val;
+}
@@ -0,0 +1,106 @@
+
+#if !defined( _WX_JSONIMAGE_H )
+#define _WX_JSONIMAGE_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+
+#include <wx/buffer.h>
+#include <wx/string.h>
+
+enum {
+    wxJSONIMAGE_INVALID = 0,
+    wxJSONIMAGE_NULL,
+    wxJSONIMAGE_BOOL,
+    wxJSONIMAGE_INT,
+    wxJSONIMAGE_UINT,
+    wxJSONIMAGE_DOUBLE,
+    wxJSONIMAGE_STRING,
+    wxJSONIMAGE_MEMORYBUFF,
+    wxJSONIMAGE_ARRAY,
+    wxJSONIMAGE_OBJECT
+};
+
+union wxJSONImageNumber;
+
+class WXDLLIMPEXP_JSON wxJSONImageValue
+{
+public:
+    wxJSONImageValue();
+    wxJSONImageValue( const char* base, size_t size, wxUint32 offset );
+
+    int      GetType() const;
+    bool     IsValid() const;
+    bool     IsNull() const;
+    bool     IsBool() const;
+    bool     IsInt() const;
+    bool     IsUInt() const;
+    bool     IsDouble() const;
+    bool     IsString() const;
+    bool     IsMemoryBuff() const;
+    bool     IsArray() const;
+    bool     IsObject() const;
+
+    bool     AsBool() const;
+    wxInt64  AsInt64() const;
+    wxUint64 AsUInt64() const;
+    double   AsDouble() const;
+    wxString AsString() const;
+    const char* AsUTF8( size_t* len = 0 ) const;
+    const void* AsMemoryBuff( size_t* len ) const;
+
+    int      Size() const;
+    wxJSONImageValue ItemAt( int index ) const;
+    wxString GetKeyAt( int index ) const;
+    wxJSONImageValue Find( const wxString& key ) const;
+    wxJSONImageValue operator [] ( const wxString& key ) const;
+    wxJSONImageValue operator [] ( int index ) const;
+
+    wxJSONValue ToValue() const;
+
+protected:
+    const wxUint32* Node() const;
+    const wxUint32* Payload( size_t bytes ) const;
+    const wxUint32* Slots( size_t* count ) const;
+    wxJSONImageValue Child( wxUint32 offset ) const;
+    int ReadNumber( wxJSONImageNumber* n ) const;
+
+    const char* m_base;
+    size_t      m_size;
+    wxUint32    m_offset;
+};
+
+class WXDLLIMPEXP_JSON wxJSONImage
+{
+public:
+    wxJSONImage();
+    wxJSONImage( const void* data, size_t size );
+    ~wxJSONImage();
+
+    bool Attach( const void* data, size_t size );
+    bool MapFile( const wxString& fileName );
+    void Close();
+
+    bool IsOk() const;
+    wxJSONImageValue GetRoot() const;
+
+    static bool Build( const wxJSONValue& root, wxMemoryBuffer& image );
+
+protected:
+    static wxUint32 BuildNode( const wxJSONValue& val, wxMemoryBuffer& image );
+    static wxUint32 BuildString( const char* utf8, size_t len, int type, wxMemoryBuffer& image );
+    static wxUint32 AppendNode( wxMemoryBuffer& image, int type, wxUint32 count,
+                            const void* payload, size_t payloadLen, size_t align );
+
+    const char* m_data;
+    size_t      m_size;
+    void*       m_mapped;
+    size_t      m_mapSize;
+
+private:
+    // not copyable
+    wxJSONImage( const wxJSONImage& );
+    wxJSONImage& operator = ( const wxJSONImage& );
+};
+
+#endif // not defined _WX_JSONIMAGE_H
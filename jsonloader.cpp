@@ -0,0 +1,384 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonloader.h"
+
+#include <wx/wfstream.h>
+#include <wx/filename.h>
+#include <wx/debug.h>
+#include <wx/log.h>
+
+
+/*! \class wxJSONFileLoader
+ \brief Parse many JSON files in parallel
+
+ The class reads a list of JSON files using a pool of worker threads and
+ passes the value read from every file to a wxJSONLoadHandler object as
+ soon as the file has been parsed.
+ Every worker thread has its own wxJSONReader object, constructed with
+ the \c flags and \c maxErrors parameters given to the loader's ctor.
+
+ The files are scheduled as follows:
+
+ \li the files are sorted by size, largest first; files that are smaller
+    than the \e batch \e size (see SetBatchSize()) are grouped in batches
+    of about that size, so that a task is either one large file or a
+    batch of small files
+ \li the tasks are dealt round-robin to one work queue for every thread:
+    each thread takes the tasks from the front of its own queue, that is
+    the largest ones first
+ \li when its own queue is empty, a thread \e steals a task from the back
+    of the queue of another thread, that is one of the smallest ones, so
+    that the owner and the thief rarely compete for the same task
+
+ The handler's wxJSONLoadHandler::OnFileLoaded() function is called by the
+ worker threads but the calls are serialized: the handler does not need
+ to be thread-safe with regard to itself.
+ The order in which the files are reported is undefined.
+
+ \par Example:
+
+ \code
+  class MyHandler : public wxJSONLoadHandler
+  {
+  public:
+    virtual void OnFileLoaded( const wxString& fileName, wxJSONValue& value,
+                    const wxArrayString& errors, const wxArrayString& warnings )
+    {
+      if ( errors.size() > 0 )  {
+        ... report the errors
+      }
+      else  {
+        m_config[fileName] = value;
+      }
+    }
+    wxJSONValue m_config;
+  };
+
+  MyHandler        handler;
+  wxJSONFileLoader loader;
+  int numFailed = loader.Load( fileNames, handler );
+ \endcode
+*/
+
+/*!
+ \struct wxJSONLoadTask
+ \brief A unit of work for wxJSONFileLoader: one large file or a batch of small ones
+*/
+struct wxJSONLoadTask
+{
+    wxArrayString files;
+    wxULongLong   size;
+};
+
+WX_DEFINE_ARRAY_PTR( wxJSONLoadTask*, wxJSONLoadTaskArray );
+
+/*!
+ \struct wxJSONLoadQueue
+ \brief The work queue of a wxJSONFileLoader worker thread
+
+ All the tasks are queued before the threads are started so the queue
+ only shrinks: the tasks that have not been taken yet are those in the
+ [head, tail) range.
+ The owner thread takes the tasks at \c head, the thieves at \c tail.
+*/
+struct wxJSONLoadQueue
+{
+    wxMutex             lock;
+    wxJSONLoadTaskArray tasks;
+    size_t              head;
+    size_t              tail;
+};
+
+/*!
+ \class wxJSONLoaderThread
+ \brief A worker thread of wxJSONFileLoader
+*/
+class wxJSONLoaderThread : public wxThread
+{
+public:
+    wxJSONLoaderThread( wxJSONFileLoader* loader, int index )
+        : wxThread( wxTHREAD_JOINABLE )
+    {
+        m_loader = loader;
+        m_index  = index;
+    }
+
+protected:
+    virtual ExitCode Entry()
+    {
+        m_loader->RunWorker( m_index );
+        return 0;
+    }
+
+    wxJSONFileLoader* m_loader;
+    int               m_index;
+};
+
+// copy the strings without sharing their data with the reader, which
+// releases its own copies in the next Parse() call without any lock
+static void
+CopyStrings( const wxArrayString& from, wxArrayString& to )
+{
+    to.Clear();
+    for ( size_t i = 0; i < from.GetCount(); i++ )  {
+        to.Add( wxString( from[i].c_str() ));
+    }
+}
+
+static int
+CompareLoadTasks( wxJSONLoadTask** first, wxJSONLoadTask** second )
+{
+    if ( (*first)->size == (*second)->size )  {
+        return 0;
+    }
+    return (*first)->size > (*second)->size ? -1 : 1;
+}
+
+/*!
+ Construct a loader object.
+
+ \param flags the flags of the wxJSONReader objects used by the worker threads
+ \param maxErrors the maximum number of errors and warnings reported for each file
+
+ By default the loader uses one thread for every CPU and a batch size
+ of 64 KBytes.
+*/
+wxJSONFileLoader::wxJSONFileLoader( int flags, int maxErrors )
+{
+    m_flags      = flags;
+    m_maxErrors  = maxErrors;
+    m_numThreads = 0;
+    m_batchSize  = 64 * 1024;
+    m_handler    = 0;
+    m_failedFiles = 0;
+}
+
+wxJSONFileLoader::~wxJSONFileLoader()
+{
+    ClearQueues();
+}
+
+/*!
+ Set the number of worker threads.
+ A value of ZERO or less (the default) means one thread for every CPU.
+*/
+void
+wxJSONFileLoader::SetThreadCount( int numThreads )
+{
+    m_numThreads = numThreads;
+}
+
+/*!
+ Set the size, in bytes, under which files are grouped in batches.
+ Small files are not worth a task of their own: the overhead of
+ scheduling them would be comparable to the time needed to parse them.
+ A value of ZERO disables batching.
+*/
+void
+wxJSONFileLoader::SetBatchSize( size_t bytes )
+{
+    m_batchSize = bytes;
+}
+
+/*!
+ The function parses all the \c files and reports every one of them to
+ \c handler.
+ It returns when all the files have been reported.
+ Files that cannot be opened are reported with an error message and an
+ invalid value.
+
+ Returns the number of files that have errors.
+*/
+int
+wxJSONFileLoader::Load( const wxArrayString& files, wxJSONLoadHandler& handler )
+{
+    int numThreads = m_numThreads;
+    if ( numThreads <= 0 )  {
+        numThreads = wxThread::GetCPUCount();
+    }
+    if ( numThreads <= 0 )  {
+        numThreads = 1;
+    }
+    if ( numThreads > (int) files.GetCount() )  {
+        numThreads = files.GetCount() > 0 ? files.GetCount() : 1;
+    }
+
+    m_handler     = &handler;
+    m_failedFiles = 0;
+    BuildQueues( files, numThreads );
+
+    // the calling thread is worker number ZERO
+    wxArrayPtrVoid threads;
+    for ( int i = 1; i < numThreads; i++ )  {
+        wxJSONLoaderThread* thread = new wxJSONLoaderThread( this, i );
+        if ( thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR )  {
+            // its queue will be emptied by the other workers
+            delete thread;
+            continue;
+        }
+        threads.Add( thread );
+    }
+    RunWorker( 0 );
+    for ( size_t i = 0; i < threads.GetCount(); i++ )  {
+        wxJSONLoaderThread* thread = (wxJSONLoaderThread*) threads[i];
+        thread->Wait();
+        delete thread;
+    }
+
+    ClearQueues();
+    m_handler = 0;
+    return m_failedFiles;
+}
+
+/*!
+ The function creates the tasks and deals them to \c numQueues work queues.
+ See the class description for the scheduling policy.
+*/
+void
+wxJSONFileLoader::BuildQueues( const wxArrayString& files, int numQueues )
+{
+    ClearQueues();
+
+    wxJSONLoadTaskArray fileTasks;
+    for ( size_t i = 0; i < files.GetCount(); i++ )  {
+        wxJSONLoadTask* task = new wxJSONLoadTask;
+        task->files.Add( files[i] );
+        task->size = wxFileName::GetSize( files[i] );
+        if ( task->size == wxInvalidSize )  {
+            task->size = 0;
+        }
+        fileTasks.Add( task );
+    }
+    fileTasks.Sort( CompareLoadTasks );
+
+    // merge the small files, which are at the end of the array, in batches
+    wxJSONLoadTaskArray tasks;
+    wxJSONLoadTask* batch = 0;
+    for ( size_t i = 0; i < fileTasks.GetCount(); i++ )  {
+        wxJSONLoadTask* task = fileTasks[i];
+        if ( task->size >= m_batchSize )  {
+            tasks.Add( task );
+            continue;
+        }
+        if ( batch != 0 && batch->size + task->size > m_batchSize )  {
+            tasks.Add( batch );
+            batch = 0;
+        }
+        if ( batch == 0 )  {
+            batch = task;
+            continue;
+        }
+        batch->files.Add( task->files[0] );
+        batch->size += task->size;
+        delete task;
+    }
+    if ( batch != 0 )  {
+        tasks.Add( batch );
+    }
+
+    for ( int i = 0; i < numQueues; i++ )  {
+        wxJSONLoadQueue* queue = new wxJSONLoadQueue;
+        queue->head = 0;
+        queue->tail = 0;
+        m_queues.Add( queue );
+    }
+    for ( size_t i = 0; i < tasks.GetCount(); i++ )  {
+        wxJSONLoadQueue* queue = m_queues[i % numQueues];
+        queue->tasks.Add( tasks[i] );
+        ++queue->tail;
+    }
+}
+
+void
+wxJSONFileLoader::ClearQueues()
+{
+    for ( size_t i = 0; i < m_queues.GetCount(); i++ )  {
+        wxJSONLoadQueue* queue = m_queues[i];
+        for ( size_t j = 0; j < queue->tasks.GetCount(); j++ )  {
+            delete queue->tasks[j];
+        }
+        delete queue;
+    }
+    m_queues.Clear();
+}
+
+/*!
+ The function returns the next task for worker \c index: the front task
+ of its own queue or, if that is empty, the back task of the first
+ non-empty queue of another worker.
+ Returns NULL when all the queues are empty.
+*/
+wxJSONLoadTask*
+wxJSONFileLoader::NextTask( int index )
+{
+    wxJSONLoadQueue* own = m_queues[index];
+    {
+        wxMutexLocker lock( own->lock );
+        if ( own->head < own->tail )  {
+            return own->tasks[own->head++];
+        }
+    }
+
+    size_t count = m_queues.GetCount();
+    for ( size_t i = 1; i < count; i++ )  {
+        wxJSONLoadQueue* victim = m_queues[( index + i ) % count];
+        wxMutexLocker lock( victim->lock );
+        if ( victim->head < victim->tail )  {
+            return victim->tasks[--victim->tail];
+        }
+    }
+    return 0;
+}
+
+//! The body of worker thread \c index
+void
+wxJSONFileLoader::RunWorker( int index )
+{
+    wxJSONReader reader( m_flags, m_maxErrors );
+
+    wxJSONLoadTask* task;
+    while ( ( task = NextTask( index )) != 0 )  {
+        for ( size_t i = 0; i < task->files.GetCount(); i++ )  {
+            LoadFile( task->files[i], reader );
+        }
+    }
+}
+
+/*!
+ The function parses the file \c fileName and passes the result to the
+ handler.
+*/
+void
+wxJSONFileLoader::LoadFile( const wxString& fileName, wxJSONReader& reader )
+{
+    wxJSONValue   value;
+    wxArrayString errors;
+    wxArrayString warnings;
+
+    wxFFileInputStream is( fileName, _T("rb"));
+    if ( !is.IsOk() )  {
+        errors.Add( _T("Error: cannot open the file") );
+    }
+    else  {
+        reader.Parse( is, &value );
+        CopyStrings( reader.GetErrors(), errors );
+        CopyStrings( reader.GetWarnings(), warnings );
+    }
+
+    wxMutexLocker lock( m_handlerLock );
+    if ( errors.GetCount() > 0 )  {
+        ++m_failedFiles;
+    }
+    m_handler->OnFileLoaded( fileName, value, errors, warnings );
+
+    // the reference counts of wxJSONValue and wxString are not atomic:
+    // if the handler kept copies, our references must be released while
+    // the calls to the handler are still serialized
+    value = wxJSONValue();
+    errors.Clear();
+    warnings.Clear();
+}
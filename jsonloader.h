@@ -0,0 +1,61 @@
+
+#if !defined( _WX_JSONLOADER_H )
+#define _WX_JSONLOADER_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+#include "jsonreader.h"
+
+#include <wx/arrstr.h>
+#include <wx/dynarray.h>
+#include <wx/thread.h>
+
+struct wxJSONLoadTask;
+struct wxJSONLoadQueue;
+
+WX_DEFINE_ARRAY_PTR( wxJSONLoadQueue*, wxJSONLoadQueueArray );
+
+class WXDLLIMPEXP_JSON wxJSONLoadHandler
+{
+public:
+    virtual ~wxJSONLoadHandler() {}
+
+    virtual void OnFileLoaded( const wxString& fileName, wxJSONValue& value,
+                        const wxArrayString& errors, const wxArrayString& warnings ) = 0;
+};
+
+class WXDLLIMPEXP_JSON wxJSONFileLoader
+{
+    friend class wxJSONLoaderThread;
+
+public:
+    wxJSONFileLoader( int flags = wxJSONREADER_TOLERANT, int maxErrors = 30 );
+    ~wxJSONFileLoader();
+
+    void SetThreadCount( int numThreads );
+    void SetBatchSize( size_t bytes );
+
+    int  Load( const wxArrayString& files, wxJSONLoadHandler& handler );
+
+protected:
+    void BuildQueues( const wxArrayString& files, int numQueues );
+    void ClearQueues();
+    void RunWorker( int index );
+    wxJSONLoadTask* NextTask( int index );
+    void LoadFile( const wxString& fileName, wxJSONReader& reader );
+
+    int     m_flags;
+    int     m_maxErrors;
+    int     m_numThreads;
+    size_t  m_batchSize;
+
+    // one work queue for every worker thread
+    wxJSONLoadQueueArray m_queues;
+
+    // serializes the calls to the handler
+    wxMutex            m_handlerLock;
+    wxJSONLoadHandler* m_handler;
+    int                m_failedFiles;
+};
+
+#endif // not defined _WX_JSONLOADER_H
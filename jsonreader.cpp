@@ -5,11 +5,32 @@
 #endif
 
 #include "jsonreader.h"
+#include "jsonsorted.h"
+#include "jsonsimd.h"
+#include "jsonimage.h"
+#include "jsontrace.h"
+#include "jsonfootprint.h"
 
 #include <wx/mstream.h>
 #include <wx/sstream.h>
 #include <wx/debug.h>
 #include <wx/log.h>
+#include <wx/strconv.h>
+#include <wx/dynarray.h>
+
+#if defined( __UNIX__ )
+#include <sys/uio.h>
+#endif
+
+// the semaphores of the static tracepoints (see jsontrace.h)
+wxJSON_DEFINE_PROBE( parse__begin )
+wxJSON_DEFINE_PROBE( parse__end )
+wxJSON_DEFINE_PROBE( container__open )
+wxJSON_DEFINE_PROBE( container__close )
+wxJSON_DEFINE_PROBE( string__read )
+wxJSON_DEFINE_PROBE( error )
+wxJSON_DEFINE_PROBE( warning )
+wxJSON_DEFINE_PROBE( buffer__refill )
 
 
 
@@ -196,6 +217,8 @@ static const wxChar* storeTraceMask = _T("StoreComment");
          string value from a stream: the reader assumes that the input stream
          is encoded in ANSI format and not in UTF-8; only meaningfull in ANSI
          builds, this flag is simply ignored in Unicode builds.
+ \li wxJSONREADER_FOOTPRINT: the parser estimates the number of bytes
+     allocated for the values that it stores (see GetFootprint())
 
  You can also use the following shortcuts to specify some predefined
  flag's combinations:
@@ -225,6 +248,14 @@ wxJSONReader::wxJSONReader( int flags, int maxErrors )
     m_maxErrors = maxErrors;
     m_peekChar  = -1;
     m_noUtf8    = false;
+    m_sortedObject = 0;
+    m_sortedParent = 0;
+    m_inBuff    = 0;
+    m_inBuffLen = 0;
+    m_inBuffBase = 0;
+    m_segments  = 0;
+    m_inSitu    = 0;
+    m_footprint = 0;
 #if !defined( wxJSON_USE_UNICODE )
     if ( m_flags & wxJSONREADER_NOUTF8_STREAM )    {
         m_noUtf8 = true;
@@ -304,10 +335,7 @@ wxJSONReader:: Parse( const wxString& doc, wxJSONValue* val )
         readBuff = utf8CB.data();
 #endif
 
-    wxCharBuffer stream = readBuff;
-    wxMemoryInputStream is( stream.data(), stream.length() );
-
-    int numErr = Parse( is, val );
+    int numErr = Parse( readBuff, strlen( readBuff ), val );
 #if !defined( wxJSON_USE_UNICODE )
     m_noUtf8 = noUtf8_bak;
 #endif
@@ -323,6 +351,7 @@ wxJSONReader::Parse( wxInputStream& is, wxJSONValue* val )
     m_lineNo   = 1;
     m_colNo    = 1;
     m_peekChar = -1;
+    m_footprint = 0;
     m_errors.clear();
     m_warnings.clear();
 
@@ -336,6 +365,8 @@ wxJSONReader::Parse( wxInputStream& is, wxJSONValue* val )
     m_lastStored = 0;
     m_current    = 0;
 
+    wxJSON_PROBE2( parse__begin, this, (long long) is.GetLength() );
+
     int ch = GetStart( is );
     switch ( ch )  {
         case '{' :
@@ -346,11 +377,376 @@ wxJSONReader::Parse( wxInputStream& is, wxJSONValue* val )
         break;
     default :
         AddError( _T("Cannot find a start object/array character" ));
+        wxJSON_PROBE4( parse__end, this, (long long) is.TellI(),
+                (int) m_errors.size(), (int) m_warnings.size() );
         return m_errors.size();
         break;
     }
 
     ch = DoRead( is, *val );
+    if ( m_flags & wxJSONREADER_FOOTPRINT )  {
+        m_footprint += wxJSONFootprint::NodeBytes( *val );
+    }
+    wxJSON_PROBE4( parse__end, this, (long long) is.TellI(),
+            (int) m_errors.size(), (int) m_warnings.size() );
+    return m_errors.size();
+}
+
+
+/*!
+ This overloaded version of the \c Parse() function reads a JSON text
+ stored in the UTF-8 memory buffer \c buff of \c len bytes.
+ The buffer is not copied: the parser reads it in place.
+
+ Because the parser has direct access to the input text, string values
+ that do not contain escape sequences are converted to \b wxString
+ directly from the input buffer instead of being first copied to a
+ temporary UTF-8 buffer; only strings that contain escape sequences
+ (or whose conversion fails) take the normal path.
+ The Parse( const wxString&, wxJSONValue* ) function also uses this one.
+
+ @param buff   the JSON text that has to be parsed
+ @param len    the length of the JSON text, in bytes
+ @param val    the wxJSONValue object that contains the parsed text; if NULL the
+         parser do not store anything but errors and warnings are reported
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::Parse( const char* buff, size_t len, wxJSONValue* val )
+{
+    wxMemoryInputStream is( buff, len );
+
+    m_inBuff    = buff;
+    m_inBuffLen = len;
+    int numErr = Parse( is, val );
+    m_inBuff    = 0;
+    m_inBuffLen = 0;
+    return numErr;
+}
+
+#if defined( __UNIX__ )
+
+/*!
+ \class wxJSONSegmentInputStream
+ \brief An input stream that reads a chain of non-contiguous memory buffers
+
+ The stream reads the \c count segments described by \c iov one after
+ the other, as if they were a single buffer, without copying them.
+ It is used by Parse( const struct iovec*, int, wxJSONValue* ).
+
+ The stream is seekable and the reader asks it, through GetSegment(), for
+ the segment that contains the current position: the text of that
+ segment is lexed in place exactly like a contiguous memory buffer and
+ the stream is read one char at a time only for the tokens that cross
+ the end of a segment.
+*/
+class wxJSONSegmentInputStream : public wxInputStream
+{
+public:
+    wxJSONSegmentInputStream( const struct iovec* iov, int count )
+    {
+        m_iov      = iov;
+        m_count    = count;
+        m_seg      = 0;
+        m_segPos   = 0;
+        m_segStart = 0;
+        m_length   = 0;
+        for ( int i = 0; i < count; i++ )  {
+            m_length += iov[i].iov_len;
+        }
+        SkipEmpty();
+    }
+
+    virtual wxFileOffset GetLength() const
+    {
+        return m_length;
+    }
+
+    virtual bool IsSeekable() const
+    {
+        return true;
+    }
+
+    // stores in 'start' the offset of the segment that contains the
+    // offset 'pos' and returns its text, or NULL if 'pos' is at EOF
+    const char* GetSegment( size_t pos, size_t* start, size_t* len ) const
+    {
+        int    seg      = m_seg;
+        size_t segStart = m_segStart;
+        while ( seg > 0 && pos < segStart )  {
+            --seg;
+            segStart -= m_iov[seg].iov_len;
+        }
+        while ( seg < m_count && pos >= segStart + m_iov[seg].iov_len )  {
+            segStart += m_iov[seg].iov_len;
+            ++seg;
+        }
+        if ( seg >= m_count )  {
+            return 0;
+        }
+        *start = segStart;
+        *len   = m_iov[seg].iov_len;
+        return (const char*) m_iov[seg].iov_base;
+    }
+
+protected:
+    virtual size_t OnSysRead( void* buffer, size_t size )
+    {
+        char*  dest    = (char*) buffer;
+        size_t numRead = 0;
+        while ( numRead < size && m_seg < m_count )  {
+            size_t avail = m_iov[m_seg].iov_len - m_segPos;
+            size_t n = size - numRead < avail ? size - numRead : avail;
+            if ( n == 1 )  {
+                dest[numRead] = ((const char*) m_iov[m_seg].iov_base)[m_segPos];
+            }
+            else  {
+                memcpy( dest + numRead, (const char*) m_iov[m_seg].iov_base + m_segPos, n );
+            }
+            m_segPos += n;
+            numRead  += n;
+            if ( m_segPos == m_iov[m_seg].iov_len )  {
+                m_segStart += m_segPos;
+                m_segPos    = 0;
+                ++m_seg;
+                SkipEmpty();
+                if ( m_seg < m_count )  {
+                    wxJSON_PROBE2( buffer__refill, (long long) m_segStart,
+                            (long) m_iov[m_seg].iov_len );
+                }
+            }
+        }
+        if ( numRead == 0 )  {
+            m_lasterror = wxSTREAM_EOF;
+        }
+        return numRead;
+    }
+
+    virtual wxFileOffset OnSysSeek( wxFileOffset pos, wxSeekMode mode )
+    {
+        switch ( mode )  {
+            case wxFromCurrent :
+                pos += m_segStart + m_segPos;
+                break;
+            case wxFromEnd :
+                pos += m_length;
+                break;
+            default :
+                break;
+        }
+        if ( pos < 0 || (size_t) pos > m_length )  {
+            return wxInvalidOffset;
+        }
+        while ( m_seg > 0 && (size_t) pos < m_segStart )  {
+            --m_seg;
+            m_segStart -= m_iov[m_seg].iov_len;
+        }
+        while ( m_seg < m_count && (size_t) pos >= m_segStart + m_iov[m_seg].iov_len )  {
+            m_segStart += m_iov[m_seg].iov_len;
+            ++m_seg;
+        }
+        m_segPos = pos - m_segStart;
+        return pos;
+    }
+
+    virtual wxFileOffset OnSysTell() const
+    {
+        return m_segStart + m_segPos;
+    }
+
+    // moves past the empty segments at the current position
+    void SkipEmpty()
+    {
+        while ( m_seg < m_count && m_iov[m_seg].iov_len == 0 )  {
+            ++m_seg;
+        }
+    }
+
+    const struct iovec* m_iov;
+    int                 m_count;
+    int                 m_seg;
+    size_t              m_segPos;
+    size_t              m_segStart;
+    size_t              m_length;
+};
+
+/*!
+ This overloaded version of the \c Parse() function reads a JSON text
+ stored in the \c count non-contiguous memory buffers described by
+ \c iov (as returned, for example, by \b readv or by a network stack
+ that uses chains of fixed-size buffers).
+ The buffers are read in order as a single UTF-8 text: tokens, strings
+ and escape sequences may span two or more buffers.
+
+ The buffers are not copied to a contiguous buffer: each one is lexed in
+ place like the buffer of Parse( const char*, size_t, wxJSONValue* ), with
+ the same fast paths for strings and whitespaces; only the tokens that
+ cross the end of a buffer are read one char at a time.
+ The \c tests/jsonsegments_bench.cpp program compares this function with
+ copying the buffers to a contiguous one and parsing it.
+
+ The function is only available on Unix-like systems.
+
+ @param iov    the array of memory buffers that contain the JSON text
+ @param count  the number of elements of \c iov
+ @param val    the wxJSONValue object that contains the parsed text; if NULL the
+         parser do not store anything but errors and warnings are reported
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::Parse( const struct iovec* iov, int count, wxJSONValue* val )
+{
+    wxJSONSegmentInputStream is( iov, count );
+
+    m_segments = &is;
+    int numErr = Parse( is, val );
+    m_segments   = 0;
+    m_inBuff     = 0;
+    m_inBuffLen  = 0;
+    m_inBuffBase = 0;
+    return numErr;
+}
+
+#endif  // __UNIX__
+
+/*!
+ This function is called by the functions that lex the input text in
+ place: it points \c m_inBuff to the memory buffer that contains the
+ stream offset \c pos, that is the whole text of a Parse( const char*,
+ size_t, wxJSONValue* ) call or the segment of a Parse( const struct
+ iovec*, int, wxJSONValue* ) call that contains \c pos.
+ \c m_inBuffBase gets the stream offset of the first byte of the buffer.
+
+ @return the pointer to the byte at \c pos or NULL if the text is not
+ in memory or \c pos is at the end of it
+*/
+const char*
+wxJSONReader::InBuffAt( wxFileOffset pos )
+{
+    if ( pos == wxInvalidOffset )  {
+        return 0;
+    }
+#if defined( __UNIX__ )
+    if ( m_segments != 0 )  {
+        size_t start, len;
+        m_inBuff = m_segments->GetSegment( pos, &start, &len );
+        if ( m_inBuff == 0 )  {
+            return 0;
+        }
+        m_inBuffBase = start;
+        m_inBuffLen  = len;
+    }
+#endif
+    if ( m_inBuff == 0 || (size_t) pos < m_inBuffBase ||
+            (size_t) pos - m_inBuffBase >= m_inBuffLen )  {
+        return 0;
+    }
+    return m_inBuff + ( pos - m_inBuffBase );
+}
+
+/*!
+ This function is the same as Parse( const char*, size_t, wxJSONValue* )
+ but the parser is allowed to modify the input buffer: the string values
+ that do not contain escape sequences are stored as \e C-string values
+ (see wxJSONValue::IsCString()) that point directly into \c buff: the
+ closing double-quote of each such string is overwritten with a NUL
+ character. No copy at all is done for these strings.
+
+ This is only possible when the characters of a \b wxString are the bytes
+ of the input text, that is in ANSI builds when the parser is constructed
+ with the \c wxJSONREADER_NOUTF8_STREAM flag.
+ In all other cases the function behaves exactly as Parse( const char*,
+ size_t, wxJSONValue* ) and the buffer is not modified.
+
+ \b Note: the buffer must outlive all the values read from it.
+
+ @param buff   the JSON text that has to be parsed; it is modified by the function
+ @param len    the length of the JSON text, in bytes
+ @param val    the wxJSONValue object that contains the parsed text
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::ParseInSitu( char* buff, size_t len, wxJSONValue* val )
+{
+    m_inSitu = buff;
+    int numErr = Parse( buff, len, val );
+    m_inSitu = 0;
+    return numErr;
+}
+
+
+/*!
+ This overloaded version of the \c Parse() function reads a JSON text
+ whose top-level value is an object and stores its members in the
+ \c obj flat array instead of a wxJSONValue.
+ The members are appended to \c obj as they are read and they are
+ sorted only once, when the whole text has been read: this is much
+ faster and uses less memory than storing a very large object in the
+ hash map of a wxJSONValue.
+ The values of the members (and all the objects they contain) are
+ stored in ordinary wxJSONValue objects.
+ See wxJSONSortedObject for more info.
+
+ The old content of \c obj is cleared.
+ If the top-level value of the JSON text is an array, an error is
+ reported and \c obj is left empty.
+
+ @param is    the input stream that contains the JSON text
+ @param obj   the sorted object that gets the top-level members
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::Parse( wxInputStream& is, wxJSONSortedObject* obj )
+{
+    wxASSERT( obj );
+    obj->Clear();
+
+    wxJSONValue root( wxJSONTYPE_OBJECT );
+    m_sortedObject = obj;
+    m_sortedParent = &root;
+
+    Parse( is, &root );
+
+    m_sortedObject = 0;
+    m_sortedParent = 0;
+
+    if ( root.IsArray() )  {
+        AddError( _T("The top-level value is an array: cannot store it in a sorted object"));
+        obj->Clear();
+    }
+    obj->Sort();
+    if ( m_flags & wxJSONREADER_FOOTPRINT )  {
+        // 'root' is discarded: the members are stored in 'obj'
+        m_footprint += obj->GetOwnBytes();
+        m_footprint -= wxJSONFootprint::NodeBytes( root );
+    }
+    return m_errors.size();
+}
+
+/*!
+ This overloaded version of the \c Parse() function reads a JSON text
+ and converts it to a position-independent memory image that is stored
+ in \c image.
+ The image can be written to a file or to a shared memory segment and
+ read by other processes through a wxJSONImage object without parsing
+ the text again.
+ See wxJSONImage for more info.
+
+ If the document does not fit in an image (4 GBytes), an error is
+ reported and \c image is left empty.
+
+ @param is    the input stream that contains the JSON text
+ @param image the memory buffer that gets the image
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::ParseToImage( wxInputStream& is, wxMemoryBuffer& image )
+{
+    wxJSONValue root;
+    Parse( is, &root );
+    if ( !wxJSONImage::Build( root, image ))  {
+        AddError( _T("The document is too large to be stored in an image"));
+    }
     return m_errors.size();
 }
 
@@ -430,6 +826,22 @@ wxJSONReader::GetWarningCount() const
     return m_warnings.size();
 }
 
+/*!
+ Return the number of bytes allocated for the values read by the last
+ call to Parse(), as computed by wxJSONFootprint::Count(), if the parser
+ was constructed with the \c wxJSONREADER_FOOTPRINT flag; otherwise
+ returns ZERO.
+ The bytes are counted while the values are stored, without walking the
+ tree again; the count is the same as the one of wxJSONFootprint::Count()
+ (an approximation, see wxJSONFootprint) if the document has no errors
+ and no duplicate member names.
+*/
+size_t
+wxJSONReader::GetFootprint() const
+{
+    return m_footprint;
+}
+
 
 /*!
  The function returns the next byte from the UTF-8 stream as an INT.
@@ -535,6 +947,9 @@ wxJSONReader::DoRead( wxInputStream& is, wxJSONValue& parent )
     m_current->SetLineNo( m_lineNo );
     m_lastStored = 0;
 
+    wxJSON_PROBE3( container__open, m_level, parent.IsArray() ? '[' : '{',
+            (long long) is.TellI() );
+
     wxString  key;
 
     int ch=0;
@@ -588,6 +1003,8 @@ wxJSONReader::DoRead( wxInputStream& is, wxJSONValue& parent )
                 m_current = &parent;
                 m_next    = 0;
                 m_current->SetLineNo( m_lineNo );
+                wxJSON_PROBE4( container__close, m_level, '{',
+                        (long long) is.TellI(), parent.Size() );
                 ch = ReadChar( is );
                 return ch;
                 break;
@@ -622,6 +1039,8 @@ wxJSONReader::DoRead( wxInputStream& is, wxJSONValue& parent )
                 m_current = &parent;
                 m_next    = 0;
                 m_current->SetLineNo( m_lineNo );
+                wxJSON_PROBE4( container__close, m_level, '[',
+                        (long long) is.TellI(), parent.Size() );
                 return 0;
                 break;
 
@@ -733,9 +1152,22 @@ wxJSONReader::StoreValue( int ch, const wxString& key, wxJSONValue& value, wxJSO
             else  {
                 wxLogTrace( traceMask, _T("(%s) adding value to key:%s"),
                      __PRETTY_FUNCTION__, key.c_str());
-                parent[key] = value;
-                m_lastStored = &(parent[key]);
+                if ( m_sortedObject != 0 && &parent == m_sortedParent )  {
+                    m_lastStored = m_sortedObject->AddMember( key, value );
+                }
+                else  {
+                    parent[key] = value;
+                    m_lastStored = &(parent[key]);
+                }
                 m_lastStored->SetLineNo( m_lineNo );
+                if ( m_flags & wxJSONREADER_FOOTPRINT )  {
+                    // the members of a sorted object are charged by
+                    // Parse( wxInputStream&, wxJSONSortedObject* )
+                    if ( m_sortedObject == 0 || &parent != m_sortedParent )  {
+                        m_footprint += wxJSONFootprint::MemberBytes( key );
+                    }
+                    m_footprint += wxJSONFootprint::NodeBytes( value );
+                }
             }
         }
         else if ( parent.IsArray() ) {
@@ -752,6 +1184,10 @@ wxJSONReader::StoreValue( int ch, const wxString& key, wxJSONValue& value, wxJSO
             wxJSON_ASSERT( arr );
             m_lastStored = &(arr->Last());
             m_lastStored->SetLineNo( m_lineNo );
+            if ( m_flags & wxJSONREADER_FOOTPRINT )  {
+                m_footprint += wxJSONFootprint::ItemBytes()
+                    + wxJSONFootprint::NodeBytes( value );
+            }
         }
         else  {
             wxJSON_ASSERT( 0 );
@@ -785,6 +1221,11 @@ wxJSONReader::AddError( const wxString& msg )
 
     wxLogTrace( traceMask, _T("(%s) %s"), __PRETTY_FUNCTION__, err.c_str());
 
+    if ( wxJSON_PROBE_ENABLED( error ))  {
+        wxCharBuffer utf8 = msg.ToUTF8();
+        wxJSON_PROBE3( error, m_lineNo, m_colNo, utf8.data() );
+    }
+
     if ( (int) m_errors.size() < m_maxErrors )  {
         m_errors.Add( err );
     }
@@ -845,6 +1286,12 @@ wxJSONReader::AddWarning( int type, const wxString& msg )
     err.Printf( _T( "Warning: line %d, col %d - %s"), m_lineNo, m_colNo, msg.c_str() );
 
     wxLogTrace( traceMask, _T("(%s) %s"), __PRETTY_FUNCTION__, err.c_str());
+
+    if ( wxJSON_PROBE_ENABLED( warning ))  {
+        wxCharBuffer utf8 = msg.ToUTF8();
+        wxJSON_PROBE3( warning, m_lineNo, m_colNo, utf8.data() );
+    }
+
     if ( (int) m_warnings.size() < m_maxErrors )  {
         m_warnings.Add( err );
     }
@@ -864,6 +1311,10 @@ wxJSONReader::AddWarning( int type, const wxString& msg )
 int
 wxJSONReader::SkipWhiteSpace( wxInputStream& is )
 {
+    if ( m_inBuff != 0 || m_segments != 0 )  {
+        SkipWhiteSpaceInPlace( is );
+    }
+
     int ch;
     do {
         ch = ReadChar( is );
@@ -877,6 +1328,43 @@ wxJSONReader::SkipWhiteSpace( wxInputStream& is )
     return ch;
 }
 
+/*!
+ This function is called by SkipWhiteSpace() when the input text is a
+ memory buffer or a chain of segments: it moves the stream past the run
+ of spaces, TABs and LFs that starts at the current position (up to the
+ end of the segment) using the vectorized
+ wxJSONSimd::SkipSpaces() kernel and updates the line and column numbers
+ accordingly.
+ The caller then goes on reading one char at a time.
+*/
+void
+wxJSONReader::SkipWhiteSpaceInPlace( wxInputStream& is )
+{
+    wxFileOffset pos   = is.TellI();
+    const char*  start = InBuffAt( pos );
+    if ( start == 0 )  {
+        return;
+    }
+
+    const char* p = wxJSONSimd::SkipSpaces( start, m_inBuff + m_inBuffLen );
+    if ( p == start )  {
+        return;
+    }
+
+    const char* lastLF = 0;
+    for ( const char* lf = start; ( lf = (const char*) memchr( lf, '\n', p - lf )) != 0; ++lf )  {
+        ++m_lineNo;
+        lastLF = lf;
+    }
+    if ( lastLF != 0 )  {
+        m_colNo = 1 + ( p - lastLF - 1 );
+    }
+    else  {
+        m_colNo += p - start;
+    }
+    is.SeekI( pos + ( p - start ));
+}
+
 /*!
  The function is called by DoRead() when a '/' (slash) character
  is read from the input stream assuming that a C/C++ comment is starting.
@@ -1027,11 +1515,16 @@ wxJSONReader::SkipComment( wxInputStream& is )
 int
 wxJSONReader::ReadString( wxInputStream& is, wxJSONValue& val )
 {
+    int ch = 0;
+    if ( ( m_inBuff != 0 || m_segments != 0 ) && !val.IsValid() )  {
+        if ( ReadStringInPlace( is, val, &ch ))  {
+            return ch;
+        }
+    }
 
     wxMemoryBuffer utf8Buff;
     char ues[8];
 
-    int ch = 0;
     while ( ch >= 0 ) {
         ch = ReadChar( is );
         unsigned char c = (unsigned char) ch;
@@ -1083,6 +1576,10 @@ wxJSONReader::ReadString( wxInputStream& is, wxJSONValue& val )
         }
     }
 
+    if ( utf8Buff.GetDataLen() >= wxJSON_TRACE_LARGE_STRING )  {
+        wxJSON_PROBE2( string__read, (long long) is.TellI(), (long) utf8Buff.GetDataLen() );
+    }
+
     wxString s;
     if ( m_noUtf8 )    {
         s = wxString::From8BitData( (const char*) utf8Buff.GetData(), utf8Buff.GetDataLen());
@@ -1122,10 +1619,14 @@ wxJSONReader::ReadString( wxInputStream& is, wxJSONValue& val )
         wxLogTrace( traceMask, _T("(%s) assigning the string to value"), __PRETTY_FUNCTION__ );
         val = s ;
     }
-    else if ( val.IsString() )  {
+    else if ( val.IsString() || val.IsCString() )  {
         AddWarning( wxJSONREADER_MULTISTRING,
             _T("Multiline strings are not allowed by JSON syntax") );
         wxLogTrace( traceMask, _T("(%s) concatenate the string to value"), __PRETTY_FUNCTION__ );
+        if ( val.IsCString() )  {
+            // read in place by ParseInSitu(): it cannot be extended
+            val = wxString( val.AsCString() );
+        }
         val.Cat( s );
     }
     else  {
@@ -1140,6 +1641,79 @@ wxJSONReader::ReadString( wxInputStream& is, wxJSONValue& val )
     return ch;
 }
 
+/*!
+ This function is called by ReadString() when the input text is a memory
+ buffer (see Parse( const char*, size_t, wxJSONValue* )) and it tries to
+ read the string value without copying it to a temporary buffer.
+
+ The function scans the input buffer from the current position up to the
+ closing double-quote: if no escape sequence and no control character
+ is found, the string is converted to a \b wxString directly from the
+ input buffer (or, when reading in place, it is stored as a C-string
+ pointing into the buffer) and the stream is moved past the closing
+ double-quote.
+ Otherwise, or if the UTF-8 conversion fails, the function returns FALSE
+ without reading anything and the caller reads the string in the
+ usual way, which also reports the errors.
+
+ @param is    the input stream, which reads text that is in memory (see InBuffAt())
+ @param val   the JSON value that gets the string; it must be invalid
+ @param nextCh on success, gets the character that follows the closing double-quote
+ @return TRUE if the string was read
+*/
+bool
+wxJSONReader::ReadStringInPlace( wxInputStream& is, wxJSONValue& val, int* nextCh )
+{
+    wxFileOffset pos   = is.TellI();
+    const char*  start = InBuffAt( pos );
+    if ( start == 0 )  {
+        return false;
+    }
+
+    const char* end   = m_inBuff + m_inBuffLen;
+    const char* p     = wxJSONSimd::ScanString( start, end );
+    if ( p >= end || *p != '\"' )  {
+        return false;
+    }
+    size_t len = p - start;
+
+#if !defined( wxJSON_USE_UNICODE )
+    if ( m_inSitu != 0 && m_noUtf8 )  {
+        m_inSitu[pos + len] = 0;
+        val = (const wxChar*) ( m_inSitu + pos );
+    }
+    else
+#endif
+    {
+        wxString s;
+        if ( m_noUtf8 )    {
+            s = wxString::From8BitData( start, len );
+        }
+        else if ( wxJSONSimd::IsAscii( start, p ))  {
+            s = wxString::FromAscii( start, len );
+        }
+        else    {
+            s = wxString::FromUTF8( start, len );
+            if ( s.empty() && len > 0 )  {
+                return false;
+            }
+        }
+        val = s;
+    }
+
+    is.SeekI( pos + len + 1 );
+    m_colNo += len + 1;
+    if ( len >= wxJSON_TRACE_LARGE_STRING )  {
+        wxJSON_PROBE2( string__read, (long long) pos, (long) len );
+    }
+    val.SetLineNo( m_lineNo );
+    wxLogTrace( traceMask, _T("(%s) string read in place, length=%d"),
+             __PRETTY_FUNCTION__, (int) len );
+
+    *nextCh = ReadChar( is );
+    return true;
+}
+
 /*!
  This function is called by the ReadValue() when the
  first character encontered is not a special char
@@ -1480,6 +2054,9 @@ wxJSONReader::StoreComment( const wxJSONValue* parent )
         m_comment.clear();
         return;
     }
+    if ( m_flags & wxJSONREADER_FOOTPRINT )  {
+        m_footprint += wxJSONFootprint::CommentBytes( m_comment );
+    }
 
     if ( m_current != 0 )  {
         wxLogTrace( storeTraceMask, _T("(%s) m_current->lineNo=%d"),
@@ -1686,7 +2263,29 @@ wxJSONReader::ReadMemoryBuff( wxInputStream& is, wxJSONValue& val )
     wxMemoryBuffer buff;
     int ch = 0; int errors = 0;
     unsigned char byte;
-    while ( ch >= 0 ) {
+    bool decoded = false;
+
+    // when reading from a memory buffer, a well-formed value (an even
+    // number of digits) is decoded at once by the vectorized kernel
+    wxFileOffset pos   = ( m_inBuff != 0 || m_segments != 0 ) ? is.TellI() : wxInvalidOffset;
+    const char*  start = InBuffAt( pos );
+    if ( start != 0 )  {
+        const char* quote = (const char*) memchr( start, '\'', m_inBuff + m_inBuffLen - start );
+        if ( quote != 0 && ( quote - start ) % 2 == 0 &&
+                memchr( start, '\n', quote - start ) == 0 &&
+                memchr( start, '\r', quote - start ) == 0 )  {
+            size_t numPairs = ( quote - start ) / 2;
+            unsigned char* out = (unsigned char*) buff.GetWriteBuf( numPairs + 1 );
+            size_t numBytes = wxJSONSimd::HexDecode( start, numPairs, out, &errors );
+            buff.UngetWriteBuf( numBytes );
+            is.SeekI( pos + ( quote - start ) + 1 );
+            m_colNo += ( quote - start ) + 1;
+            ch = '\'';
+            decoded = true;
+        }
+    }
+
+    while ( ch >= 0 && !decoded ) {
         ch = ReadChar( is );
         if ( ch < 0 )  {
             break;
@@ -1750,6 +2349,559 @@ wxJSONReader::ReadMemoryBuff( wxInputStream& is, wxJSONValue& val )
 
 
 
+/*!
+ \struct wxJSONCanonMember
+ \brief A member of a JSON object that is being canonicalized
+
+ The \c sortKey is the UTF-16BE encoding of the member's name: comparing
+ two keys with \b memcmp gives the UTF-16 code unit order required by
+ RFC 8785.
+ The \c text holds the canonical \c "name":value text of the member and
+ \c seq is the position of the member in the input text, used to resolve
+ duplicate names (the last one wins, as in Parse()).
+*/
+struct wxJSONCanonMember
+{
+    wxMemoryBuffer sortKey;
+    wxMemoryBuffer text;
+    int            seq;
+};
+
+WX_DEFINE_ARRAY_PTR( wxJSONCanonMember*, wxJSONCanonMemberArray );
+
+static int
+CompareCanonMembers( wxJSONCanonMember** first, wxJSONCanonMember** second )
+{
+    const wxMemoryBuffer& k1 = (*first)->sortKey;
+    const wxMemoryBuffer& k2 = (*second)->sortKey;
+    size_t len1 = k1.GetDataLen();
+    size_t len2 = k2.GetDataLen();
+
+    int r = memcmp( k1.GetData(), k2.GetData(), len1 < len2 ? len1 : len2 );
+    if ( r == 0 )  {
+        if ( len1 != len2 )  {
+            r = len1 < len2 ? -1 : 1;
+        }
+        else  {
+            r = (*first)->seq - (*second)->seq;
+        }
+    }
+    return r;
+}
+
+/*!
+ The two overloaded versions of the \c Canonicalize() function read a
+ JSON text stored in a wxString object or in a wxInputStream object and
+ write its canonical form to the \c canon memory buffer.
+
+ The canonical form is the one defined by RFC 8785 (JSON Canonicalization
+ Scheme): object members are sorted by name (comparing UTF-16 code units),
+ no whitespace is written between tokens, strings only use the
+ mandatory escape sequences and numbers are written in their shortest
+ round-trip form.
+ The output is encoded in UTF-8 and is suitable to compute signatures and
+ hashes of JSON documents.
+
+ Unlike Parse() this function does not build a wxJSONValue tree: values
+ are written to \c canon as soon as they are read and only the members of
+ the objects that are currently open are buffered in order to sort them.
+ Comments are recognized (subject to the parser's flags) but they are
+ not written to the output; the \e memory \e buffer extension has no
+ canonical representation and it is reported as an error.
+
+ Note that RFC 8785 numbers are IEEE 754 doubles so integer values that
+ cannot be exactly represented as a double lose precision.
+
+ @param is    the input stream that contains the JSON text
+ @param canon the memory buffer to which the canonical UTF-8 text is appended
+ @return the total number of errors encontered
+*/
+int
+wxJSONReader::Canonicalize( const wxString& doc, wxMemoryBuffer& canon )
+{
+#if !defined( wxJSON_USE_UNICODE )
+    bool noUtf8_bak = m_noUtf8;
+    m_noUtf8 = true;
+#endif
+
+    char* readBuff = 0;
+    wxCharBuffer utf8CB = doc.ToUTF8();
+#if !defined( wxJSON_USE_UNICODE )
+    wxCharBuffer ansiCB( doc.c_str());
+    if ( m_noUtf8 )    {
+        readBuff = ansiCB.data();
+    }
+    else    {
+        readBuff = utf8CB.data();
+    }
+#else
+        readBuff = utf8CB.data();
+#endif
+
+    wxCharBuffer stream = readBuff;
+    wxMemoryInputStream is( stream.data(), stream.length() );
+
+    int numErr = Canonicalize( is, canon );
+#if !defined( wxJSON_USE_UNICODE )
+    m_noUtf8 = noUtf8_bak;
+#endif
+    return numErr;
+}
+
+int
+wxJSONReader::Canonicalize( wxInputStream& is, wxMemoryBuffer& canon )
+{
+    m_level    = 0;
+    m_depth    = 0;
+    m_lineNo   = 1;
+    m_colNo    = 1;
+    m_peekChar = -1;
+    m_errors.clear();
+    m_warnings.clear();
+
+    m_next       = 0;
+    m_lastStored = 0;
+    m_current    = 0;
+
+    int ch = GetStart( is );
+    m_comment.clear();
+    if ( ch != '{' && ch != '[' )  {
+        AddError( _T("Cannot find a start object/array character" ));
+        return m_errors.size();
+    }
+
+    ch = DoCanonicalize( is, ch, canon );
+    return m_errors.size();
+}
+
+/*!
+ This is the recursive function that does the actual work for
+ \c Canonicalize(): it is the counterpart of \c DoRead() and it reads
+ the JSON text up to the close-object/array character that
+ corresponds to \c openCh.
+
+ Array elements are written to \c canon as soon as they are complete.
+ Object members are canonicalized in their own memory buffer and
+ they are sorted and written to \c canon when the object is closed.
+
+ @param is     the input stream that contains the JSON text
+ @param openCh the open-object or open-array character just read
+ @param canon  the memory buffer to which the canonical text is appended
+ @return ZERO if the container was closed or -1 on EOF
+*/
+int
+wxJSONReader::DoCanonicalize( wxInputStream& is, int openCh, wxMemoryBuffer& canon )
+{
+    ++m_level;
+    if ( m_depth < m_level )    {
+        m_depth = m_level;
+    }
+
+    bool isObject = ( openCh == '{' );
+    wxJSONCanonMemberArray members;
+    wxJSONValue    value( wxJSONTYPE_INVALID );
+    wxMemoryBuffer item;
+    wxMemoryBuffer sortKey;
+    bool hasKey    = false;
+    bool hasNested = false;
+    bool closed    = false;
+    int  numItems  = 0;
+
+    canon.AppendByte( isObject ? '{' : '[' );
+
+    int ch = ReadChar( is );
+    while ( ch >= 0 && !closed )  {
+        switch ( ch )  {
+            case ' ' :
+            case '\t' :
+            case '\n' :
+            case '\r' :
+                ch = SkipWhiteSpace( is );
+                break;
+
+            case '/' :
+                ch = SkipComment( is );
+                m_comment.clear();
+                break;
+
+            case '{' :
+            case '[' :
+                if ( isObject && !hasKey )  {
+                    AddError( _T("\'%c\' is not allowed here (\'name\' is missing"), (wxChar) ch );
+                }
+                if ( value.IsValid() || hasNested )  {
+                    AddError( _T("\'%c\' cannot follow a \'value\'"), (wxChar) ch );
+                }
+                ch = DoCanonicalize( is, ch, item );
+                hasNested = true;
+                if ( ch == 0 )  {
+                    ch = ReadChar( is );
+                }
+                break;
+
+            case '}' :
+            case ']' :
+                if ( ch == '}' && !isObject )  {
+                    AddWarning( wxJSONREADER_MISSING,
+                    _T("Trying to close an array using the \'}\' (close-object) char" ));
+                }
+                else if ( ch == ']' && isObject )  {
+                    AddWarning( wxJSONREADER_MISSING,
+                    _T("Trying to close an object using the \']\' (close-array) char" ));
+                }
+                closed = true;
+                // fall through
+
+            case ',' :
+                if ( !value.IsValid() && !hasNested && !hasKey )  {
+                    if ( ch == ',' )  {
+                        AddError( _T("key or value is missing for JSON value"));
+                    }
+                }
+                else if ( !value.IsValid() && !hasNested )  {
+                    AddError( _T("cannot store the value: \'value\' is missing for JSON object type"));
+                }
+                else if ( isObject && !hasKey )  {
+                    AddError( _T("cannot store the value: \'key\' is missing for JSON object type"));
+                }
+                else  {
+                    if ( value.IsValid() )  {
+                        if ( hasNested )  {
+                            AddError( _T("Value cannot follow a value: \',\' or \':\' missing?"));
+                        }
+                        CanonWriteValue( value, item );
+                    }
+                    if ( isObject )  {
+                        wxJSONCanonMember* member = new wxJSONCanonMember;
+                        member->sortKey = sortKey;
+                        member->text    = item;
+                        member->seq     = numItems;
+                        members.Add( member );
+                    }
+                    else  {
+                        if ( numItems > 0 )  {
+                            canon.AppendByte( ',' );
+                        }
+                        canon.AppendData( item.GetData(), item.GetDataLen() );
+                    }
+                    ++numItems;
+                }
+                // the member keeps a reference to the old buffers
+                item    = wxMemoryBuffer();
+                sortKey = wxMemoryBuffer();
+                value.SetType( wxJSONTYPE_INVALID );
+                hasKey    = false;
+                hasNested = false;
+                ch = closed ? 0 : ReadChar( is );
+                break;
+
+            case '\"' :
+                ch = ReadString( is, value );
+                break;
+
+            case '\'' :
+                ch = ReadMemoryBuff( is, value );
+                break;
+
+            case ':' :
+                if ( !isObject )  {
+                    AddError( _T( "\':\' can only used in object's values" ));
+                }
+                else if ( !value.IsString() )  {
+                    AddError( _T( "\':\' follows a value which is not of type \'string\'" ));
+                }
+                else if ( hasKey )  {
+                    AddError( _T( "\':\' not allowed where a \'name\' string was already available" ));
+                }
+                else  {
+                    wxString key = value.AsString();
+                    wxMBConvUTF16BE utf16be;
+                    size_t len = utf16be.FromWChar( 0, 0, key.wc_str(), key.length() );
+                    if ( len != wxCONV_FAILED )  {
+                        utf16be.FromWChar( (char*) sortKey.GetWriteBuf( len ), len,
+                                        key.wc_str(), key.length() );
+                        sortKey.UngetWriteBuf( len );
+                    }
+                    CanonWriteString( key, item );
+                    item.AppendByte( ':' );
+                    hasKey = true;
+                    value.SetType( wxJSONTYPE_INVALID );
+                }
+                ch = ReadChar( is );
+                break;
+
+            default :
+                ch = ReadValue( is, ch, value );
+                break;
+        }
+    }
+
+    if ( !closed )  {
+        if ( isObject )  {
+            AddWarning( wxJSONREADER_MISSING, _T("\'}\' missing at end of file"));
+        }
+        else  {
+            AddWarning( wxJSONREADER_MISSING, _T("\']\' missing at end of file"));
+        }
+        if ( value.IsValid() || hasNested )  {
+            if ( value.IsValid() )  {
+                CanonWriteValue( value, item );
+            }
+            if ( isObject && hasKey )  {
+                wxJSONCanonMember* member = new wxJSONCanonMember;
+                member->sortKey = sortKey;
+                member->text    = item;
+                member->seq     = numItems;
+                members.Add( member );
+            }
+            else if ( !isObject )  {
+                if ( numItems > 0 )  {
+                    canon.AppendByte( ',' );
+                }
+                canon.AppendData( item.GetData(), item.GetDataLen() );
+            }
+        }
+    }
+
+    if ( isObject )  {
+        // sort by name; equal names are ordered by position so that
+        // only the last one of each run is written
+        members.Sort( CompareCanonMembers );
+        bool first = true;
+        size_t count = members.GetCount();
+        for ( size_t i = 0; i < count; i++ )  {
+            wxJSONCanonMember* member = members[i];
+            if ( i + 1 < count )  {
+                const wxMemoryBuffer& k1 = member->sortKey;
+                const wxMemoryBuffer& k2 = members[i + 1]->sortKey;
+                if ( k1.GetDataLen() == k2.GetDataLen() &&
+                     memcmp( k1.GetData(), k2.GetData(), k1.GetDataLen() ) == 0 )  {
+                    delete member;
+                    continue;
+                }
+            }
+            if ( !first )  {
+                canon.AppendByte( ',' );
+            }
+            canon.AppendData( member->text.GetData(), member->text.GetDataLen() );
+            first = false;
+            delete member;
+        }
+    }
+
+    canon.AppendByte( isObject ? '}' : ']' );
+
+    --m_level;
+    return ch;
+}
+
+/*!
+ The function writes the canonical form of the scalar value \c val
+ to the \c canon memory buffer.
+ Numbers are converted to double and written by \c CanonWriteNumber(),
+ strings by \c CanonWriteString().
+ Memory buffers are not valid JSON text and have no canonical
+ representation: an error is reported.
+*/
+void
+wxJSONReader::CanonWriteValue( const wxJSONValue& val, wxMemoryBuffer& canon )
+{
+    double d = 0;
+    switch ( val.GetType() )  {
+        case wxJSONTYPE_NULL :
+            canon.AppendData( "null", 4 );
+            return;
+        case wxJSONTYPE_BOOL :
+            if ( val.AsBool() )  {
+                canon.AppendData( "true", 4 );
+            }
+            else  {
+                canon.AppendData( "false", 5 );
+            }
+            return;
+        case wxJSONTYPE_STRING :
+        case wxJSONTYPE_CSTRING :
+            CanonWriteString( val.AsString(), canon );
+            return;
+        case wxJSONTYPE_DOUBLE :
+            d = val.AsDouble();
+            break;
+        case wxJSONTYPE_UINT :
+        case wxJSONTYPE_USHORT :
+        case wxJSONTYPE_ULONG :
+        case wxJSONTYPE_UINT64 :
+#if defined( wxJSON_64BIT_INT )
+            d = (double) val.AsUInt64();
+#else
+            d = (double) val.AsULong();
+#endif
+            break;
+        case wxJSONTYPE_INT :
+        case wxJSONTYPE_SHORT :
+        case wxJSONTYPE_LONG :
+        case wxJSONTYPE_INT64 :
+#if defined( wxJSON_64BIT_INT )
+            d = (double) val.AsInt64();
+#else
+            d = (double) val.AsLong();
+#endif
+            break;
+        case wxJSONTYPE_MEMORYBUFF :
+            AddError( _T( "the \'memory buffer\' type has no canonical representation" ));
+            return;
+        default :
+            wxJSON_ASSERT( 0 );
+            return;
+    }
+
+    if ( !CanonWriteNumber( d, canon ))  {
+        AddError( _T( "Numeric value is not a finite number and has no canonical representation" ));
+    }
+}
+
+/*!
+ The function writes the string \c s to the \c canon memory buffer as
+ a double-quoted UTF-8 string.
+ As required by RFC 8785, only the double quote, the backslash and the
+ control characters are escaped; the control characters that have a
+ short escape sequence (\\b, \\t, \\n, \\f and \\r) use it, all the other
+ ones are written as \\u00xx with lowercase hex digits.
+*/
+void
+wxJSONReader::CanonWriteString( const wxString& s, wxMemoryBuffer& canon )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    wxCharBuffer utf8 = s.ToUTF8();
+    const char* p = utf8.data();
+    size_t len = utf8.length();
+
+    canon.AppendByte( '\"' );
+    for ( size_t i = 0; i < len; i++ )  {
+        unsigned char c = (unsigned char) p[i];
+        switch ( c )  {
+            case '\"' :
+                canon.AppendData( "\\\"", 2 );
+                break;
+            case '\\' :
+                canon.AppendData( "\\\\", 2 );
+                break;
+            case '\b' :
+                canon.AppendData( "\\b", 2 );
+                break;
+            case '\t' :
+                canon.AppendData( "\\t", 2 );
+                break;
+            case '\n' :
+                canon.AppendData( "\\n", 2 );
+                break;
+            case '\f' :
+                canon.AppendData( "\\f", 2 );
+                break;
+            case '\r' :
+                canon.AppendData( "\\r", 2 );
+                break;
+            default :
+                if ( c < 0x20 )  {
+                    char ues[6] = { '\\', 'u', '0', '0', 0, 0 };
+                    ues[4] = hexDigits[c >> 4];
+                    ues[5] = hexDigits[c & 0x0F];
+                    canon.AppendData( ues, 6 );
+                }
+                else  {
+                    canon.AppendByte( (char) c );
+                }
+                break;
+        }
+    }
+    canon.AppendByte( '\"' );
+}
+
+/*!
+ The function writes the double \c d to the \c canon memory buffer using
+ the ECMAScript \b Number.prototype.toString() algorithm, as required
+ by RFC 8785: the shortest decimal digit string that converts back to
+ \c d is selected and it is written in plain notation when the decimal
+ exponent is in the range [-6, 21) and in exponential notation otherwise.
+ Negative zero is written as \c 0.
+
+ Returns FALSE if \c d is NaN or infinite: such values have no JSON
+ representation.
+*/
+bool
+wxJSONReader::CanonWriteNumber( double d, wxMemoryBuffer& canon )
+{
+    if ( d != d || d - d != 0 )  {
+        return false;
+    }
+    if ( d == 0 )  {
+        canon.AppendByte( '0' );
+        return true;
+    }
+
+    char buff[40];
+    for ( int prec = 0; prec < 17; prec++ )  {
+        snprintf( buff, sizeof( buff ), "%.*e", prec, d );
+        if ( strtod( buff, 0 ) == d )  {
+            break;
+        }
+    }
+
+    // collect the significant digits and the exponent: d = 0.DIGITS * 10^n
+    char digits[20];
+    int  numDigits = 0;
+    bool negative  = false;
+    const char* p = buff;
+    if ( *p == '-' )  {
+        negative = true;
+        ++p;
+    }
+    for ( ; *p != 0 && *p != 'e'; p++ )  {
+        if ( *p >= '0' && *p <= '9' )  {
+            digits[numDigits++] = *p;
+        }
+    }
+    int n = atoi( *p == 'e' ? p + 1 : p ) + 1;
+    while ( numDigits > 1 && digits[numDigits - 1] == '0' )  {
+        --numDigits;
+    }
+
+    if ( negative )  {
+        canon.AppendByte( '-' );
+    }
+    if ( numDigits <= n && n <= 21 )  {
+        canon.AppendData( digits, numDigits );
+        for ( int i = numDigits; i < n; i++ )  {
+            canon.AppendByte( '0' );
+        }
+    }
+    else if ( 0 < n && n <= 21 )  {
+        canon.AppendData( digits, n );
+        canon.AppendByte( '.' );
+        canon.AppendData( digits + n, numDigits - n );
+    }
+    else if ( -6 < n && n <= 0 )  {
+        canon.AppendData( "0.", 2 );
+        for ( int i = n; i < 0; i++ )  {
+            canon.AppendByte( '0' );
+        }
+        canon.AppendData( digits, numDigits );
+    }
+    else  {
+        canon.AppendByte( digits[0] );
+        if ( numDigits > 1 )  {
+            canon.AppendByte( '.' );
+            canon.AppendData( digits + 1, numDigits - 1 );
+        }
+        snprintf( buff, sizeof( buff ), "e%c%d", n - 1 < 0 ? '-' : '+',
+                n - 1 < 0 ? 1 - n : n - 1 );
+        canon.AppendData( buff, strlen( buff ));
+    }
+    return true;
+}
+
+
+
 #if defined( wxJSON_64BIT_INT )
 /*!
  This function implements a simple variant
@@ -0,0 +1,492 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonsimd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ))
+#define wxJSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+/*! \class wxJSONSimd
+ \brief Runtime selection of the vectorized scanning kernels of the parser
+
+ When the parser reads a JSON text stored in a memory buffer (see
+ wxJSONReader::Parse( const char*, size_t, wxJSONValue* )) it scans the
+ text in large blocks using the following kernels:
+
+ \li \c ScanString: returns the first double-quote, backslash or control
+    character in the range, or \c end
+ \li \c SkipSpaces: returns the first character in the range that is not a
+    space, a TAB or a LF, or \c end
+ \li \c IsAscii: returns TRUE if no byte of the range has the high bit set;
+    such a string needs no UTF-8 decoding
+ \li \c HexDecode: decodes \c numPairs pairs of hexadecimal digits of a
+    \e memory \e buffer value, stores the valid ones in \c out and adds
+    the number of invalid pairs to \c errors; returns the number of bytes
+    stored. The digits are interpreted exactly as ReadMemoryBuff() does
+
+ Every kernel has a scalar, an SSE4.2, an AVX2 and an AVX-512 (BW)
+ implementation; a single binary contains all of them.
+ The best level supported by the CPU is detected once, when the library
+ is loaded, and the kernels are called through function pointers.
+
+ The level can be lowered (for example to compare the results and the
+ speed of all the levels on the same machine) by calling SetLevel() or
+ by setting the \c WXJSON_SIMD environment variable to one of
+ \c scalar, \c sse4.2, \c avx2 or \c avx512 before the program starts.
+ A level higher than the one supported by the CPU is never selected.
+
+ The vectorized levels are only available on x86 CPUs when the library is
+ compiled with GCC or Clang; in all other cases only the scalar level
+ is available.
+*/
+
+
+//
+// scalar kernels
+//
+
+static const char*
+ScanStringScalar( const char* p, const char* end )
+{
+    while ( p < end && *p != '\"' && *p != '\\' && (unsigned char) *p >= 0x20 )  {
+        ++p;
+    }
+    return p;
+}
+
+static const char*
+SkipSpacesScalar( const char* p, const char* end )
+{
+    while ( p < end && ( *p == ' ' || *p == '\t' || *p == '\n' ))  {
+        ++p;
+    }
+    return p;
+}
+
+static bool
+IsAsciiScalar( const char* p, const char* end )
+{
+    unsigned char acc = 0;
+    while ( p < end )  {
+        acc |= (unsigned char) *p++;
+    }
+    return ( acc & 0x80 ) == 0;
+}
+
+// same conversion as wxJSONReader::ReadMemoryBuff()
+static size_t
+HexDecodeScalar( const char* p, size_t numPairs, unsigned char* out, int* errors )
+{
+    size_t numBytes = 0;
+    for ( size_t i = 0; i < numPairs; i++ )  {
+        unsigned char c1 = (unsigned char) p[i * 2];
+        unsigned char c2 = (unsigned char) p[i * 2 + 1];
+        c1 -= '0';
+        c2 -= '0';
+        if ( c1 > 9 )  {
+            c1 -= 7;
+        }
+        if ( c2 > 9 )  {
+            c2 -= 7;
+        }
+        if ( c1 > 15 || c2 > 15 )  {
+            ++(*errors);
+        }
+        else  {
+            out[numBytes++] = (unsigned char) (( c1 * 16 ) + c2 );
+        }
+    }
+    return numBytes;
+}
+
+
+#if defined( wxJSON_SIMD_X86 )
+
+//
+// SSE4.2 kernels
+//
+
+__attribute__(( target( "sse4.2" )))
+static const char*
+ScanStringSSE42( const char* p, const char* end )
+{
+    // ranges: control characters, double-quote, backslash
+    const __m128i ranges = _mm_setr_epi8( 0x00, 0x1F, '\"', '\"', '\\', '\\',
+                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+    while ( end - p >= 16 )  {
+        __m128i v = _mm_loadu_si128( (const __m128i*) p );
+        int i = _mm_cmpestri( ranges, 6, v, 16,
+                    _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT );
+        if ( i < 16 )  {
+            return p + i;
+        }
+        p += 16;
+    }
+    return ScanStringScalar( p, end );
+}
+
+__attribute__(( target( "sse4.2" )))
+static const char*
+SkipSpacesSSE42( const char* p, const char* end )
+{
+    const __m128i sp = _mm_set1_epi8( ' ' );
+    const __m128i tab = _mm_set1_epi8( '\t' );
+    const __m128i lf = _mm_set1_epi8( '\n' );
+    while ( end - p >= 16 )  {
+        __m128i v = _mm_loadu_si128( (const __m128i*) p );
+        __m128i ws = _mm_or_si128( _mm_cmpeq_epi8( v, sp ),
+                    _mm_or_si128( _mm_cmpeq_epi8( v, tab ), _mm_cmpeq_epi8( v, lf )));
+        unsigned int mask = ~(unsigned int) _mm_movemask_epi8( ws ) & 0xFFFF;
+        if ( mask != 0 )  {
+            return p + __builtin_ctz( mask );
+        }
+        p += 16;
+    }
+    return SkipSpacesScalar( p, end );
+}
+
+__attribute__(( target( "sse4.2" )))
+static bool
+IsAsciiSSE42( const char* p, const char* end )
+{
+    __m128i acc = _mm_setzero_si128();
+    while ( end - p >= 16 )  {
+        acc = _mm_or_si128( acc, _mm_loadu_si128( (const __m128i*) p ));
+        p += 16;
+    }
+    return _mm_movemask_epi8( acc ) == 0 && IsAsciiScalar( p, end );
+}
+
+// nibble values of 16 digits; 'bad' gets 0xFF in the lanes of invalid digits
+__attribute__(( target( "sse4.2" )))
+static inline __m128i
+HexNibblesSSE42( __m128i v, __m128i* bad )
+{
+    v = _mm_sub_epi8( v, _mm_set1_epi8( '0' ));
+    __m128i nine = _mm_set1_epi8( 9 );
+    __m128i gt9 = _mm_xor_si128( _mm_cmpeq_epi8( _mm_min_epu8( v, nine ), v ),
+                    _mm_set1_epi8( (char) 0xFF ));
+    v = _mm_sub_epi8( v, _mm_and_si128( gt9, _mm_set1_epi8( 7 )));
+    __m128i fifteen = _mm_set1_epi8( 15 );
+    *bad = _mm_xor_si128( _mm_cmpeq_epi8( _mm_min_epu8( v, fifteen ), v ),
+                    _mm_set1_epi8( (char) 0xFF ));
+    return v;
+}
+
+__attribute__(( target( "sse4.2" )))
+static size_t
+HexDecodeSSE42( const char* p, size_t numPairs, unsigned char* out, int* errors )
+{
+    const __m128i weights = _mm_set1_epi16( 0x0110 );
+    size_t numBytes = 0;
+    size_t i = 0;
+    for ( ; i + 8 <= numPairs; i += 8 )  {
+        __m128i bad;
+        __m128i v = HexNibblesSSE42( _mm_loadu_si128( (const __m128i*) ( p + i * 2 )), &bad );
+        if ( _mm_movemask_epi8( bad ) != 0 )  {
+            numBytes += HexDecodeScalar( p + i * 2, 8, out + numBytes, errors );
+            continue;
+        }
+        __m128i w = _mm_maddubs_epi16( v, weights );
+        _mm_storel_epi64( (__m128i*) ( out + numBytes ), _mm_packus_epi16( w, w ));
+        numBytes += 8;
+    }
+    return numBytes + HexDecodeScalar( p + i * 2, numPairs - i, out + numBytes, errors );
+}
+
+
+//
+// AVX2 kernels
+//
+
+__attribute__(( target( "avx2" )))
+static const char*
+ScanStringAVX2( const char* p, const char* end )
+{
+    const __m256i quote = _mm256_set1_epi8( '\"' );
+    const __m256i bslash = _mm256_set1_epi8( '\\' );
+    const __m256i ctrl = _mm256_set1_epi8( 0x1F );
+    while ( end - p >= 32 )  {
+        __m256i v = _mm256_loadu_si256( (const __m256i*) p );
+        __m256i m = _mm256_or_si256( _mm256_cmpeq_epi8( v, quote ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, bslash ),
+                    _mm256_cmpeq_epi8( _mm256_max_epu8( v, ctrl ), ctrl )));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8( m );
+        if ( mask != 0 )  {
+            return p + __builtin_ctz( mask );
+        }
+        p += 32;
+    }
+    return ScanStringSSE42( p, end );
+}
+
+__attribute__(( target( "avx2" )))
+static const char*
+SkipSpacesAVX2( const char* p, const char* end )
+{
+    const __m256i sp = _mm256_set1_epi8( ' ' );
+    const __m256i tab = _mm256_set1_epi8( '\t' );
+    const __m256i lf = _mm256_set1_epi8( '\n' );
+    while ( end - p >= 32 )  {
+        __m256i v = _mm256_loadu_si256( (const __m256i*) p );
+        __m256i ws = _mm256_or_si256( _mm256_cmpeq_epi8( v, sp ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, tab ), _mm256_cmpeq_epi8( v, lf )));
+        unsigned int mask = ~(unsigned int) _mm256_movemask_epi8( ws );
+        if ( mask != 0 )  {
+            return p + __builtin_ctz( mask );
+        }
+        p += 32;
+    }
+    return SkipSpacesSSE42( p, end );
+}
+
+__attribute__(( target( "avx2" )))
+static bool
+IsAsciiAVX2( const char* p, const char* end )
+{
+    __m256i acc = _mm256_setzero_si256();
+    while ( end - p >= 32 )  {
+        acc = _mm256_or_si256( acc, _mm256_loadu_si256( (const __m256i*) p ));
+        p += 32;
+    }
+    return _mm256_movemask_epi8( acc ) == 0 && IsAsciiSSE42( p, end );
+}
+
+__attribute__(( target( "avx2" )))
+static size_t
+HexDecodeAVX2( const char* p, size_t numPairs, unsigned char* out, int* errors )
+{
+    const __m256i nine = _mm256_set1_epi8( 9 );
+    const __m256i fifteen = _mm256_set1_epi8( 15 );
+    const __m256i weights = _mm256_set1_epi16( 0x0110 );
+    size_t numBytes = 0;
+    size_t i = 0;
+    for ( ; i + 16 <= numPairs; i += 16 )  {
+        __m256i v = _mm256_loadu_si256( (const __m256i*) ( p + i * 2 ));
+        v = _mm256_sub_epi8( v, _mm256_set1_epi8( '0' ));
+        __m256i le9 = _mm256_cmpeq_epi8( _mm256_min_epu8( v, nine ), v );
+        v = _mm256_sub_epi8( v, _mm256_andnot_si256( le9, _mm256_set1_epi8( 7 )));
+        __m256i ok = _mm256_cmpeq_epi8( _mm256_min_epu8( v, fifteen ), v );
+        if ( (unsigned int) _mm256_movemask_epi8( ok ) != 0xFFFFFFFFu )  {
+            numBytes += HexDecodeScalar( p + i * 2, 16, out + numBytes, errors );
+            continue;
+        }
+        __m256i w = _mm256_maddubs_epi16( v, weights );
+        __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( w, w ), 0x08 );
+        _mm_storeu_si128( (__m128i*) ( out + numBytes ), _mm256_castsi256_si128( packed ));
+        numBytes += 16;
+    }
+    return numBytes + HexDecodeSSE42( p + i * 2, numPairs - i, out + numBytes, errors );
+}
+
+
+//
+// AVX-512 (BW) kernels
+//
+
+__attribute__(( target( "avx512f,avx512bw" )))
+static const char*
+ScanStringAVX512( const char* p, const char* end )
+{
+    const __m512i quote = _mm512_set1_epi8( '\"' );
+    const __m512i bslash = _mm512_set1_epi8( '\\' );
+    const __m512i ctrl = _mm512_set1_epi8( 0x1F );
+    while ( end - p >= 64 )  {
+        __m512i v = _mm512_loadu_si512( (const void*) p );
+        __mmask64 m = _mm512_cmpeq_epi8_mask( v, quote ) |
+                    _mm512_cmpeq_epi8_mask( v, bslash ) |
+                    _mm512_cmple_epu8_mask( v, ctrl );
+        if ( m != 0 )  {
+            return p + __builtin_ctzll( m );
+        }
+        p += 64;
+    }
+    return ScanStringAVX2( p, end );
+}
+
+__attribute__(( target( "avx512f,avx512bw" )))
+static const char*
+SkipSpacesAVX512( const char* p, const char* end )
+{
+    const __m512i sp = _mm512_set1_epi8( ' ' );
+    const __m512i tab = _mm512_set1_epi8( '\t' );
+    const __m512i lf = _mm512_set1_epi8( '\n' );
+    while ( end - p >= 64 )  {
+        __m512i v = _mm512_loadu_si512( (const void*) p );
+        __mmask64 ws = _mm512_cmpeq_epi8_mask( v, sp ) |
+                    _mm512_cmpeq_epi8_mask( v, tab ) |
+                    _mm512_cmpeq_epi8_mask( v, lf );
+        if ( ~ws != 0 )  {
+            return p + __builtin_ctzll( ~ws );
+        }
+        p += 64;
+    }
+    return SkipSpacesAVX2( p, end );
+}
+
+__attribute__(( target( "avx512f,avx512bw" )))
+static bool
+IsAsciiAVX512( const char* p, const char* end )
+{
+    __m512i acc = _mm512_setzero_si512();
+    while ( end - p >= 64 )  {
+        acc = _mm512_or_si512( acc, _mm512_loadu_si512( (const void*) p ));
+        p += 64;
+    }
+    return _mm512_movepi8_mask( acc ) == 0 && IsAsciiAVX2( p, end );
+}
+
+__attribute__(( target( "avx512f,avx512bw" )))
+static size_t
+HexDecodeAVX512( const char* p, size_t numPairs, unsigned char* out, int* errors )
+{
+    const __m512i nine = _mm512_set1_epi8( 9 );
+    const __m512i fifteen = _mm512_set1_epi8( 15 );
+    const __m512i weights = _mm512_set1_epi16( 0x0110 );
+    size_t numBytes = 0;
+    size_t i = 0;
+    for ( ; i + 32 <= numPairs; i += 32 )  {
+        __m512i v = _mm512_loadu_si512( (const void*) ( p + i * 2 ));
+        v = _mm512_sub_epi8( v, _mm512_set1_epi8( '0' ));
+        __mmask64 gt9 = _mm512_cmpgt_epu8_mask( v, nine );
+        v = _mm512_mask_sub_epi8( v, gt9, v, _mm512_set1_epi8( 7 ));
+        if ( _mm512_cmpgt_epu8_mask( v, fifteen ) != 0 )  {
+            numBytes += HexDecodeScalar( p + i * 2, 32, out + numBytes, errors );
+            continue;
+        }
+        __m512i w = _mm512_maddubs_epi16( v, weights );
+        _mm256_storeu_si256( (__m256i*) ( out + numBytes ), _mm512_maskz_cvtepi16_epi8( (__mmask32) ~0u, w ));
+        numBytes += 32;
+    }
+    return numBytes + HexDecodeAVX2( p + i * 2, numPairs - i, out + numBytes, errors );
+}
+
+#endif  // wxJSON_SIMD_X86
+
+
+//
+// dispatching
+//
+
+const char* (*wxJSONSimd::s_scanString)( const char*, const char* ) = ScanStringScalar;
+const char* (*wxJSONSimd::s_skipSpaces)( const char*, const char* ) = SkipSpacesScalar;
+bool        (*wxJSONSimd::s_isAscii)( const char*, const char* ) = IsAsciiScalar;
+size_t      (*wxJSONSimd::s_hexDecode)( const char*, size_t, unsigned char*, int* ) = HexDecodeScalar;
+wxJSONSimdLevel wxJSONSimd::s_level = wxJSONSIMD_SCALAR;
+
+static const char* s_levelNames[] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+//! Return the level of the kernels in use
+wxJSONSimdLevel
+wxJSONSimd::GetLevel()
+{
+    return s_level;
+}
+
+//! Return the best level supported by the CPU
+wxJSONSimdLevel
+wxJSONSimd::GetMaxLevel()
+{
+    wxJSONSimdLevel level = wxJSONSIMD_SCALAR;
+#if defined( wxJSON_SIMD_X86 )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "sse4.2" ))  {
+        level = wxJSONSIMD_SSE42;
+        if ( __builtin_cpu_supports( "avx2" ))  {
+            level = wxJSONSIMD_AVX2;
+            if ( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ))  {
+                level = wxJSONSIMD_AVX512;
+            }
+        }
+    }
+#endif
+    return level;
+}
+
+/*!
+ Select the kernels of \c level or, if the CPU does not support it, of the
+ best level supported by the CPU.
+ Returns the level actually selected.
+
+ The function is not thread-safe: it must not be called while other
+ threads are parsing.
+*/
+wxJSONSimdLevel
+wxJSONSimd::SetLevel( wxJSONSimdLevel level )
+{
+    wxJSONSimdLevel maxLevel = GetMaxLevel();
+    if ( level > maxLevel )  {
+        level = maxLevel;
+    }
+
+    s_scanString = ScanStringScalar;
+    s_skipSpaces = SkipSpacesScalar;
+    s_isAscii    = IsAsciiScalar;
+    s_hexDecode  = HexDecodeScalar;
+#if defined( wxJSON_SIMD_X86 )
+    switch ( level )  {
+        case wxJSONSIMD_SSE42 :
+            s_scanString = ScanStringSSE42;
+            s_skipSpaces = SkipSpacesSSE42;
+            s_isAscii    = IsAsciiSSE42;
+            s_hexDecode  = HexDecodeSSE42;
+            break;
+        case wxJSONSIMD_AVX2 :
+            s_scanString = ScanStringAVX2;
+            s_skipSpaces = SkipSpacesAVX2;
+            s_isAscii    = IsAsciiAVX2;
+            s_hexDecode  = HexDecodeAVX2;
+            break;
+        case wxJSONSIMD_AVX512 :
+            s_scanString = ScanStringAVX512;
+            s_skipSpaces = SkipSpacesAVX512;
+            s_isAscii    = IsAsciiAVX512;
+            s_hexDecode  = HexDecodeAVX512;
+            break;
+        default :
+            break;
+    }
+#endif
+    s_level = level;
+    return level;
+}
+
+//! Return the name of \c level, as used by the \c WXJSON_SIMD environment variable
+const char*
+wxJSONSimd::GetLevelName( wxJSONSimdLevel level )
+{
+    return s_levelNames[level];
+}
+
+/*!
+ \class wxJSONSimdInit
+ \brief Select the best kernels when the library is loaded
+
+ Until this object is constructed the scalar kernels are used.
+*/
+static class wxJSONSimdInit
+{
+public:
+    wxJSONSimdInit()
+    {
+        wxJSONSimdLevel level = wxJSONSIMD_AVX512;
+        const char* env = getenv( "WXJSON_SIMD" );
+        if ( env != 0 )  {
+            for ( int i = wxJSONSIMD_SCALAR; i <= wxJSONSIMD_AVX512; i++ )  {
+                if ( strcmp( env, s_levelNames[i] ) == 0 )  {
+                    level = (wxJSONSimdLevel) i;
+                }
+            }
+        }
+        wxJSONSimd::SetLevel( level );
+    }
+} s_simdInit;
@@ -0,0 +1,42 @@
+
+#if !defined( _WX_JSONSIMD_H )
+#define _WX_JSONSIMD_H
+
+#include "json_defs.h"
+
+#include <stddef.h>
+
+enum wxJSONSimdLevel {
+    wxJSONSIMD_SCALAR = 0,
+    wxJSONSIMD_SSE42,
+    wxJSONSIMD_AVX2,
+    wxJSONSIMD_AVX512
+};
+
+class WXDLLIMPEXP_JSON wxJSONSimd
+{
+public:
+    static wxJSONSimdLevel GetLevel();
+    static wxJSONSimdLevel GetMaxLevel();
+    static wxJSONSimdLevel SetLevel( wxJSONSimdLevel level );
+    static const char*     GetLevelName( wxJSONSimdLevel level );
+
+    // the kernels of the current level
+    static const char* ScanString( const char* p, const char* end )
+        { return s_scanString( p, end ); }
+    static const char* SkipSpaces( const char* p, const char* end )
+        { return s_skipSpaces( p, end ); }
+    static bool IsAscii( const char* p, const char* end )
+        { return s_isAscii( p, end ); }
+    static size_t HexDecode( const char* p, size_t numPairs, unsigned char* out, int* errors )
+        { return s_hexDecode( p, numPairs, out, errors ); }
+
+protected:
+    static const char* (*s_scanString)( const char*, const char* );
+    static const char* (*s_skipSpaces)( const char*, const char* );
+    static bool        (*s_isAscii)( const char*, const char* );
+    static size_t      (*s_hexDecode)( const char*, size_t, unsigned char*, int* );
+    static wxJSONSimdLevel s_level;
+};
+
+#endif // not defined _WX_JSONSIMD_H
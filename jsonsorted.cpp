@@ -0,0 +1,331 @@
+
+
+#ifdef NDEBUG
+#define wxDEBUG_LEVEL 0
+#endif
+
+#include "jsonsorted.h"
+
+#include <wx/debug.h>
+#include <string.h>
+
+
+/*! \class wxJSONSortedObject
+ \brief A JSON object stored as a flat array sorted by member name
+
+ Objects that have tens of thousands of members (for example maps from
+ an ID to a record) are expensive to build and to store in the hash map
+ used by wxJSONValue: every member costs a hash node and every insertion
+ may rehash the table.
+ This class stores the members of one such object in a flat array: the
+ members are appended while the JSON text is read, the array is sorted
+ only once when the object is complete and lookups use a binary search.
+
+ Member names are stored as UTF-8 in a single memory buffer.
+ For every member the class also keeps the first eight bytes of its
+ name packed in a 64-bit integer (the \e prefix): the binary search
+ compares the prefixes, which are contiguous in memory and are compared
+ eight bytes at a time.
+ Names that share their first eight bytes (as \c "record-000123" and
+ \c "record-000124" do) have the same prefix: the search goes on with a
+ second binary search on the full names, restricted to the members that
+ have the prefix of the searched name, so a lookup takes O(log n) name
+ comparisons in the worst case.
+ The prefix search loop is branchless so that its cost does not depend
+ on branch prediction.
+
+ The object is filled by the wxJSONReader::Parse( wxInputStream&, wxJSONSortedObject* )
+ function; the values of the members are ordinary wxJSONValue objects.
+
+ \par Example:
+
+ \code
+  wxJSONSortedObject records;
+  wxJSONReader       reader;
+
+  wxFFileInputStream jsonText( _T("records.json"), _T("r"));
+  int numErrors = reader.Parse( jsonText, &records );
+
+  const wxJSONValue* rec = records.Find( _T("id-12345") );
+  if ( rec != 0 )  {
+    ...
+  }
+ \endcode
+*/
+
+/*!
+ \struct wxJSONSortedMember
+ \brief A member of a wxJSONSortedObject
+
+ \c keyOffset and \c keyLength locate the UTF-8 name of the member in
+ the object's key buffer; \c seq is the insertion order of the member and
+ it is used to keep the last one of duplicate names.
+ \c keys is the start of the key buffer: the buffer may move while
+ members are added so it is only set by Sort(), for the comparison
+ function, which has no other way to reach the object being sorted.
+*/
+struct wxJSONSortedMember
+{
+    wxUint64    prefix;
+    const char* keys;
+    size_t      keyOffset;
+    size_t      keyLength;
+    int         seq;
+    wxJSONValue value;
+};
+
+// compare two UTF-8 names: byte by byte, then the shorter one first
+static int
+CompareKeys( const char* key1, size_t len1, const char* key2, size_t len2 )
+{
+    int r = memcmp( key1, key2, len1 < len2 ? len1 : len2 );
+    if ( r == 0 && len1 != len2 )  {
+        r = len1 < len2 ? -1 : 1;
+    }
+    return r;
+}
+
+static int
+CompareSortedMembers( wxJSONSortedMember** first, wxJSONSortedMember** second )
+{
+    const wxJSONSortedMember* m1 = *first;
+    const wxJSONSortedMember* m2 = *second;
+
+    if ( m1->prefix != m2->prefix )  {
+        return m1->prefix < m2->prefix ? -1 : 1;
+    }
+    int r = CompareKeys( m1->keys + m1->keyOffset, m1->keyLength,
+                        m2->keys + m2->keyOffset, m2->keyLength );
+    if ( r == 0 )  {
+        r = m1->seq - m2->seq;
+    }
+    return r;
+}
+
+wxJSONSortedObject::wxJSONSortedObject()
+{
+    m_prefixes = 0;
+    m_sorted   = true;
+}
+
+wxJSONSortedObject::~wxJSONSortedObject()
+{
+    Clear();
+}
+
+//! Remove all the members
+void
+wxJSONSortedObject::Clear()
+{
+    size_t count = m_members.GetCount();
+    for ( size_t i = 0; i < count; i++ )  {
+        delete m_members[i];
+    }
+    m_members.Clear();
+    m_keys.SetDataLen( 0 );
+    delete [] m_prefixes;
+    m_prefixes = 0;
+    m_sorted   = true;
+}
+
+/*!
+ The function appends a member to the object and returns a pointer to
+ the stored value, which remains valid until the object is cleared
+ or destroyed.
+ The object is not sorted after this call: Sort() must be called
+ before the members can be searched.
+*/
+wxJSONValue*
+wxJSONSortedObject::AddMember( const wxString& key, const wxJSONValue& value )
+{
+    wxCharBuffer utf8 = key.ToUTF8();
+
+    wxJSONSortedMember* member = new wxJSONSortedMember;
+    member->keys      = 0;
+    member->keyOffset = m_keys.GetDataLen();
+    member->keyLength = utf8.length();
+    member->prefix    = KeyPrefix( utf8.data(), utf8.length() );
+    member->seq       = m_members.GetCount();
+    member->value     = value;
+    m_keys.AppendData( utf8.data(), utf8.length() );
+    m_members.Add( member );
+
+    m_sorted = false;
+    return &member->value;
+}
+
+/*!
+ The function sorts the members by name and builds the lookup table.
+ If a name appears more than once, only the last member with that name
+ is kept, as it happens when the object is stored in a wxJSONValue.
+*/
+void
+wxJSONSortedObject::Sort()
+{
+    if ( m_sorted )  {
+        return;
+    }
+
+    const char* keys = (const char*) m_keys.GetData();
+    size_t count = m_members.GetCount();
+    for ( size_t i = 0; i < count; i++ )  {
+        m_members[i]->keys = keys;
+    }
+    m_members.Sort( CompareSortedMembers );
+
+    size_t last  = 0;
+    for ( size_t i = 0; i < count; i++ )  {
+        wxJSONSortedMember* member = m_members[i];
+        if ( i + 1 < count )  {
+            const wxJSONSortedMember* next = m_members[i + 1];
+            if ( member->keyLength == next->keyLength &&
+                 memcmp( keys + member->keyOffset, keys + next->keyOffset,
+                        member->keyLength ) == 0 )  {
+                delete member;
+                continue;
+            }
+        }
+        m_members[last++] = member;
+    }
+    m_members.RemoveAt( last, count - last );
+
+    delete [] m_prefixes;
+    m_prefixes = new wxUint64[last > 0 ? last : 1];
+    for ( size_t i = 0; i < last; i++ )  {
+        m_prefixes[i] = m_members[i]->prefix;
+    }
+    m_sorted = true;
+}
+
+//! Return TRUE if the members were sorted after the last AddMember() call
+bool
+wxJSONSortedObject::IsSorted() const
+{
+    return m_sorted;
+}
+
+/*!
+ Return the number of bytes allocated by the object itself: the member
+ array, the member structures (which hold the wxJSONValue objects), the
+ key buffer and the prefix table.
+ The data of the members' values is not included: see
+ wxJSONFootprint::Count( const wxJSONSortedObject& ).
+*/
+size_t
+wxJSONSortedObject::GetOwnBytes() const
+{
+    size_t count = m_members.GetCount();
+    size_t bytes = m_members.capacity() * sizeof( void* )
+        + count * sizeof( wxJSONSortedMember )
+        + m_keys.GetBufSize();
+    if ( m_prefixes != 0 )  {
+        bytes += ( count > 0 ? count : 1 ) * sizeof( wxUint64 );
+    }
+    return bytes;
+}
+
+//! Return the number of members
+size_t
+wxJSONSortedObject::GetCount() const
+{
+    return m_members.GetCount();
+}
+
+//! Return the name of the member at \c index (in key order once sorted)
+wxString
+wxJSONSortedObject::GetKey( size_t index ) const
+{
+    const wxJSONSortedMember* member = m_members[index];
+    return wxString::FromUTF8( (const char*) m_keys.GetData() + member->keyOffset,
+                        member->keyLength );
+}
+
+//! Return the value of the member at \c index (in key order once sorted)
+const wxJSONValue&
+wxJSONSortedObject::GetValue( size_t index ) const
+{
+    return m_members[index]->value;
+}
+
+/*!
+ The function searches the member whose name is \c key and returns a
+ pointer to its value or NULL if there is no such member.
+ The object must be sorted.
+*/
+const wxJSONValue*
+wxJSONSortedObject::Find( const wxString& key ) const
+{
+    wxASSERT( m_sorted );
+    size_t count = m_members.GetCount();
+    if ( count == 0 || !m_sorted )  {
+        return 0;
+    }
+
+    wxCharBuffer utf8 = key.ToUTF8();
+    size_t   len    = utf8.length();
+    wxUint64 prefix = KeyPrefix( utf8.data(), len );
+
+    // branchless lower bound of 'prefix' in the prefix table
+    const wxUint64* base = m_prefixes;
+    size_t n = count;
+    while ( n > 1 )  {
+        size_t half = n / 2;
+        base = ( base[half - 1] < prefix ) ? base + half : base;
+        n -= half;
+    }
+    size_t first = ( base - m_prefixes ) + ( *base < prefix );
+    if ( first == count || m_prefixes[first] != prefix )  {
+        return 0;
+    }
+
+    // branchless upper bound of 'prefix': the members from 'first' to
+    // 'last' (excluded) all have the prefix of the searched name
+    base = m_prefixes + first;
+    n = count - first;
+    while ( n > 1 )  {
+        size_t half = n / 2;
+        base = ( base[half - 1] <= prefix ) ? base + half : base;
+        n -= half;
+    }
+    size_t last = ( base - m_prefixes ) + ( *base <= prefix );
+
+    // binary search on the full names among the members that share
+    // the prefix: they are sorted by name and the names are unique
+    const char* keys = (const char*) m_keys.GetData();
+    while ( first < last )  {
+        size_t mid = first + ( last - first ) / 2;
+        const wxJSONSortedMember* member = m_members[mid];
+        int r = CompareKeys( keys + member->keyOffset, member->keyLength,
+                            utf8.data(), len );
+        if ( r == 0 )  {
+            return &member->value;
+        }
+        if ( r < 0 )  {
+            first = mid + 1;
+        }
+        else  {
+            last = mid;
+        }
+    }
+    return 0;
+}
+
+/*!
+ The function packs the first eight bytes of the UTF-8 name \c key in a
+ 64-bit integer, first byte in the most significant position, so that
+ comparing two prefixes as integers gives the same result as comparing
+ the first eight bytes of the names.
+ Names shorter than eight bytes are padded with zeroes.
+*/
+wxUint64
+wxJSONSortedObject::KeyPrefix( const char* key, size_t len )
+{
+    wxUint64 prefix = 0;
+    for ( size_t i = 0; i < 8; i++ )  {
+        prefix <<= 8;
+        if ( i < len )  {
+            prefix |= (unsigned char) key[i];
+        }
+    }
+    return prefix;
+}
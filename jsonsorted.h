@@ -0,0 +1,52 @@
+
+#if !defined( _WX_JSONSORTED_H )
+#define _WX_JSONSORTED_H
+
+#include "json_defs.h"
+#include "jsonval.h"
+
+#include <wx/buffer.h>
+#include <wx/dynarray.h>
+
+struct wxJSONSortedMember;
+
+WX_DEFINE_ARRAY_PTR( wxJSONSortedMember*, wxJSONSortedMemberArray );
+
+class WXDLLIMPEXP_JSON wxJSONSortedObject
+{
+public:
+    wxJSONSortedObject();
+    ~wxJSONSortedObject();
+
+    void         Clear();
+    wxJSONValue* AddMember( const wxString& key, const wxJSONValue& value );
+    void         Sort();
+
+    bool         IsSorted() const;
+    size_t       GetCount() const;
+    wxString     GetKey( size_t index ) const;
+    const wxJSONValue& GetValue( size_t index ) const;
+    const wxJSONValue* Find( const wxString& key ) const;
+
+    size_t       GetOwnBytes() const;
+
+protected:
+    static wxUint64 KeyPrefix( const char* key, size_t len );
+
+    // the members in insertion order while building, in key order after Sort()
+    wxJSONSortedMemberArray m_members;
+
+    // the UTF-8 names of all the members
+    wxMemoryBuffer m_keys;
+
+    // the key prefix of each member, in key order: built by Sort()
+    wxUint64*  m_prefixes;
+    bool       m_sorted;
+
+private:
+    // not copyable
+    wxJSONSortedObject( const wxJSONSortedObject& );
+    wxJSONSortedObject& operator = ( const wxJSONSortedObject& );
+};
+
+#endif // not defined _WX_JSONSORTED_H
@@ -0,0 +1,87 @@
+
+/*
+ The parser defines the following static tracepoints (provider 'wxjson')
+ that can be attached by perf, bpftrace, SystemTap or any other tool that
+ reads the SystemTap SDT notes of the ELF binary:
+
+   parse__begin      reader, length of the input (-1 if not known)
+   parse__end        reader, byte offset, errors, warnings
+   container__open   depth, '{' or '[', byte offset
+   container__close  depth, '{' or '[', byte offset, number of items
+   string__read      byte offset, length in bytes (only strings larger
+                     than wxJSON_TRACE_LARGE_STRING bytes)
+   error             line, column, UTF-8 message
+   warning           line, column, UTF-8 message
+   buffer__refill    byte offset, number of bytes available
+
+ For example:
+
+   bpftrace -e 'usdt:./app:wxjson:parse__begin { @s[tid] = nsecs; }
+                usdt:./app:wxjson:parse__end /@s[tid]/ {
+                    @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+
+ The tracepoints are compiled in only if the library is built with the
+ wxJSON_USE_SDT symbol defined and <sys/sdt.h> is available (package
+ systemtap-sdt-dev or systemtap-sdt-devel); otherwise they expand to
+ nothing.
+ Every tracepoint has a semaphore that is set by the tool while it is
+ attached: the arguments (some of them, like the byte offsets, have a cost)
+ are only computed when the tracepoint is enabled.
+ When no tool is attached, a tracepoint costs one test of a global
+ variable.
+*/
+
+#if !defined( _WX_JSONTRACE_H )
+#define _WX_JSONTRACE_H
+
+#if !defined( wxJSON_TRACE_LARGE_STRING )
+#define wxJSON_TRACE_LARGE_STRING   4096
+#endif
+
+#if defined( wxJSON_USE_SDT ) && defined( __UNIX__ )
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define wxJSON_PROBE_SEMAPHORE( name )  wxjson_##name##_semaphore
+
+// defines the semaphore of a tracepoint: used once in the library
+#define wxJSON_DEFINE_PROBE( name ) \
+    extern "C" { unsigned short wxJSON_PROBE_SEMAPHORE( name ) \
+        __attribute__(( unused, section( ".probes" ))) = 0; }
+
+#define wxJSON_PROBE_ENABLED( name ) \
+    __builtin_expect( wxJSON_PROBE_SEMAPHORE( name ) != 0, 0 )
+
+#define wxJSON_PROBE2( name, a1, a2 ) \
+    do { if ( wxJSON_PROBE_ENABLED( name ))  { \
+        STAP_PROBE2( wxjson, name, a1, a2 ); } } while ( 0 )
+#define wxJSON_PROBE3( name, a1, a2, a3 ) \
+    do { if ( wxJSON_PROBE_ENABLED( name ))  { \
+        STAP_PROBE3( wxjson, name, a1, a2, a3 ); } } while ( 0 )
+#define wxJSON_PROBE4( name, a1, a2, a3, a4 ) \
+    do { if ( wxJSON_PROBE_ENABLED( name ))  { \
+        STAP_PROBE4( wxjson, name, a1, a2, a3, a4 ); } } while ( 0 )
+
+extern "C" {
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( parse__begin );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( parse__end );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( container__open );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( container__close );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( string__read );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( error );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( warning );
+    extern unsigned short wxJSON_PROBE_SEMAPHORE( buffer__refill );
+}
+
+#else
+
+#define wxJSON_DEFINE_PROBE( name )
+#define wxJSON_PROBE_ENABLED( name )            0
+#define wxJSON_PROBE2( name, a1, a2 )           do { } while ( 0 )
+#define wxJSON_PROBE3( name, a1, a2, a3 )       do { } while ( 0 )
+#define wxJSON_PROBE4( name, a1, a2, a3, a4 )   do { } while ( 0 )
+
+#endif  // wxJSON_USE_SDT
+
+#endif  // not defined _WX_JSONTRACE_H
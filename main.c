@@ -43,6 +43,7 @@
 #include <linux/io.h>
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
+#include <linux/dynamic_queue_limits.h>
 #include <asm/unaligned.h>
 
 #include "b43.h"
@@ -113,6 +114,26 @@ static int b43_modparam_pio = 0;
 module_param_named(pio, b43_modparam_pio, int, 0644);
 MODULE_PARM_DESC(pio, "Use PIO accesses by default: 0=DMA, 1=PIO");
 
+static int modparam_fastfwupload = 1;
+module_param_named(fastfwupload, modparam_fastfwupload, int, 0644);
+MODULE_PARM_DESC(fastfwupload, "Upload the microcode without per-word delay "
+		 "and verify it (default on)");
+
+static int modparam_txbatch = 16;
+module_param_named(txbatch, modparam_txbatch, int, 0644);
+MODULE_PARM_DESC(txbatch, "Maximum number of frames taken off a TX queue "
+		 "per queue lock round trip (default 16)");
+
+static int modparam_txsched = B43_TXSCHED_STRICT;
+module_param_named(txsched, modparam_txsched, int, 0644);
+MODULE_PARM_DESC(txsched, "TX queue scheduling: 0=strict priority (default), "
+		 "1=deficit round robin");
+
+static int modparam_pollbudget = 64;
+module_param_named(pollbudget, modparam_pollbudget, int, 0644);
+MODULE_PARM_DESC(pollbudget, "Maximum number of TX status reports handled "
+		 "per interrupt or poll (default 64)");
+
 #ifdef CONFIG_B43_BCMA
 static const struct bcma_device_id b43_bcma_tbl[] = {
 	BCMA_CORE(BCMA_MANUF_BCM, BCMA_CORE_80211, 0x11, BCMA_ANY_CLASS),
@@ -436,6 +457,51 @@ static void b43_ram_write(struct b43_wldev *dev, u16 offset, u32 val)
 	b43_write32(dev, B43_MMIO_RAM_DATA, val);
 }
 
+#if B43_DEBUG
+/* Bring-up timing.
+ * The bring-up phases report their duration when the "verbose_stats"
+ * debugfs knob is set. The MMIO transactions and the bus time of these
+ * paths are measured against the simulated register backend of the
+ * KUnit tests (main_test.c), which sees every register access.
+ */
+struct b43_bringup_phase {
+	const char *name;
+	ktime_t start;
+};
+
+static void b43_bringup_phase_begin(struct b43_wldev *dev,
+				    struct b43_bringup_phase *phase,
+				    const char *name)
+{
+	phase->name = name;
+	phase->start = ktime_get();
+}
+
+static void b43_bringup_phase_end(struct b43_wldev *dev,
+				  struct b43_bringup_phase *phase)
+{
+	s64 us = ktime_us_delta(ktime_get(), phase->start);
+
+	if (!b43_debug(dev, B43_DBG_VERBOSESTATS))
+		return;
+	b43dbg(dev->wl, "%s: %lld us\n", phase->name, (long long)us);
+}
+#else /* B43_DEBUG */
+struct b43_bringup_phase {
+};
+
+static inline void b43_bringup_phase_begin(struct b43_wldev *dev,
+					   struct b43_bringup_phase *phase,
+					   const char *name)
+{
+}
+
+static inline void b43_bringup_phase_end(struct b43_wldev *dev,
+					 struct b43_bringup_phase *phase)
+{
+}
+#endif /* B43_DEBUG */
+
 static inline void b43_shm_control_word(struct b43_wldev *dev,
 					u16 routing, u16 offset)
 {
@@ -528,16 +594,131 @@ void b43_shm_write16(struct b43_wldev *dev, u16 routing, u16 offset, u16 value)
 	b43_write16(dev, B43_MMIO_SHM_DATA, value);
 }
 
+/* Set up an auto-incrementing write burst at "offset"; the address
+ * advances by one word after each data write. As for the other SHM
+ * accessors, "offset" is a byte offset for B43_SHM_SHARED and a word
+ * offset for the other routings. */
+static void b43_shm_burst_start(struct b43_wldev *dev,
+				u16 routing, u16 offset)
+{
+	if (routing == B43_SHM_SHARED) {
+		B43_WARN_ON(offset & 0x0003);
+		offset >>= 2;
+	}
+	b43_shm_control_word(dev, routing | B43_SHM_AUTOINC_W, offset);
+}
+
+/* Write "count" 32bit words (big-endian, as found in the firmware files)
+ * to consecutive SHM locations. One control word write is followed by
+ * one data write per word, instead of two writes per word. */
+static void b43_shm_write_bulk(struct b43_wldev *dev, u16 routing, u16 offset,
+			       const __be32 *data, unsigned int count)
+{
+	unsigned int i;
+
+	b43_shm_burst_start(dev, routing, offset);
+	for (i = 0; i < count; i++)
+		b43_write32(dev, B43_MMIO_SHM_DATA, be32_to_cpu(data[i]));
+}
+
+/* Write "count" 16bit words to consecutive shared memory locations at
+ * the byte offset "offset", pairing them into auto-incrementing 32bit
+ * writes. A lone 16bit word at an unaligned start or at the end is
+ * written on its own. */
+static void b43_shm_write16_burst(struct b43_wldev *dev, u16 offset,
+				  const u16 *words, unsigned int count)
+{
+	unsigned int i;
+
+	if (count && (offset & 0x0003)) {
+		b43_shm_write16(dev, B43_SHM_SHARED, offset, words[0]);
+		offset += 2;
+		words++;
+		count--;
+	}
+	if (count >= 2) {
+		b43_shm_burst_start(dev, B43_SHM_SHARED, offset);
+		for (i = 0; i + 1 < count; i += 2) {
+			b43_write32(dev, B43_MMIO_SHM_DATA,
+				    words[i] | ((u32)words[i + 1] << 16));
+		}
+	}
+	if (count & 1) {
+		b43_shm_write16(dev, B43_SHM_SHARED, offset + (count - 1) * 2,
+				words[count - 1]);
+	}
+}
+
+/* Zero "count" 32bit words at consecutive SHM locations. */
+static void b43_shm_clear_bulk(struct b43_wldev *dev, u16 routing, u16 offset,
+			       unsigned int count)
+{
+	unsigned int i;
+
+	b43_shm_burst_start(dev, routing, offset);
+	for (i = 0; i < count; i++)
+		b43_write32(dev, B43_MMIO_SHM_DATA, 0);
+}
+
+/* Shadow of SHM words.
+ * Some shared memory words are only ever written by the driver, so a
+ * copy in memory is as good as reading them through the SHM control and
+ * data registers. Each word is read from the device once and then kept
+ * up to date by b43_shm_shadow_write16(). The microcode upload and the
+ * initvals upload write the shared memory behind our back, so they drop
+ * the whole shadow.
+ */
+static const u16 b43_shm_shadow_offsets[B43_NR_SHM_SHADOW] = {
+	[B43_SHADOW_HOSTF1]		= B43_SHM_SH_HOSTF1,
+	[B43_SHADOW_HOSTF2]		= B43_SHM_SH_HOSTF2,
+	[B43_SHADOW_HOSTF3]		= B43_SHM_SH_HOSTF3,
+	[B43_SHADOW_BEACPHYCTL]		= B43_SHM_SH_BEACPHYCTL,
+	[B43_SHADOW_ACKCTSPHYCTL]	= B43_SHM_SH_ACKCTSPHYCTL,
+	[B43_SHADOW_PRPHYCTL]		= B43_SHM_SH_PRPHYCTL,
+};
+
+static void b43_shm_shadow_invalidate(struct b43_wldev *dev)
+{
+	dev->shm_shadow.valid = 0;
+}
+
+static u16 b43_shm_shadow_read16(struct b43_wldev *dev,
+				 enum b43_shm_shadow_word word)
+{
+	struct b43_shm_shadow *shadow = &dev->shm_shadow;
+
+	if (!(shadow->valid & BIT(word))) {
+		shadow->value[word] = b43_shm_read16(dev, B43_SHM_SHARED,
+						b43_shm_shadow_offsets[word]);
+		shadow->valid |= BIT(word);
+	}
+
+	return shadow->value[word];
+}
+
+static void b43_shm_shadow_write16(struct b43_wldev *dev,
+				   enum b43_shm_shadow_word word, u16 value)
+{
+	struct b43_shm_shadow *shadow = &dev->shm_shadow;
+
+	if ((shadow->valid & BIT(word)) && shadow->value[word] == value)
+		return;
+	b43_shm_write16(dev, B43_SHM_SHARED, b43_shm_shadow_offsets[word],
+			value);
+	shadow->value[word] = value;
+	shadow->valid |= BIT(word);
+}
+
 /* Read HostFlags */
 u64 b43_hf_read(struct b43_wldev *dev)
 {
 	u64 ret;
 
-	ret = b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF3);
+	ret = b43_shm_shadow_read16(dev, B43_SHADOW_HOSTF3);
 	ret <<= 16;
-	ret |= b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF2);
+	ret |= b43_shm_shadow_read16(dev, B43_SHADOW_HOSTF2);
 	ret <<= 16;
-	ret |= b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF1);
+	ret |= b43_shm_shadow_read16(dev, B43_SHADOW_HOSTF1);
 
 	return ret;
 }
@@ -550,9 +731,9 @@ void b43_hf_write(struct b43_wldev *dev, u64 value)
 	lo = (value & 0x00000000FFFFULL);
 	mi = (value & 0x0000FFFF0000ULL) >> 16;
 	hi = (value & 0xFFFF00000000ULL) >> 32;
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF1, lo);
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF2, mi);
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_HOSTF3, hi);
+	b43_shm_shadow_write16(dev, B43_SHADOW_HOSTF1, lo);
+	b43_shm_shadow_write16(dev, B43_SHADOW_HOSTF2, mi);
+	b43_shm_shadow_write16(dev, B43_SHADOW_HOSTF3, hi);
 }
 
 /* Read the firmware capabilities bitmask (Opensource firmware only) */
@@ -787,6 +968,7 @@ void b43_dummy_transmission(struct b43_wldev *dev, bool ofdm, bool pa_on)
 static void key_write(struct b43_wldev *dev,
 		      u8 index, u8 algorithm, const u8 *key)
 {
+	u16 words[B43_SEC_KEYSIZE / 2];
 	unsigned int i;
 	u32 offset;
 	u16 value;
@@ -803,8 +985,9 @@ static void key_write(struct b43_wldev *dev,
 	for (i = 0; i < B43_SEC_KEYSIZE; i += 2) {
 		value = key[i];
 		value |= (u16) (key[i + 1]) << 8;
-		b43_shm_write16(dev, B43_SHM_SHARED, offset + i, value);
+		words[i / 2] = value;
 	}
+	b43_shm_write16_burst(dev, offset, words, ARRAY_SIZE(words));
 }
 
 static void keymac_write(struct b43_wldev *dev, u8 index, const u8 *addr)
@@ -860,6 +1043,7 @@ static void keymac_write(struct b43_wldev *dev, u8 index, const u8 *addr)
 static void rx_tkip_phase1_write(struct b43_wldev *dev, u8 index, u32 iv32,
 		u16 *phase1key)
 {
+	u16 words[5 + 2];
 	unsigned int i;
 	u32 offset;
 	u8 pairwise_keys_start = B43_NR_GROUP_KEYS * 2;
@@ -885,12 +1069,11 @@ static void rx_tkip_phase1_write(struct b43_wldev *dev, u8 index, u32 iv32,
 	}
 	/* Write the key to the  RX tkip shared mem */
 	offset = B43_SHM_SH_TKIPTSCTTAK + index * (10 + 4);
-	for (i = 0; i < 10; i += 2) {
-		b43_shm_write16(dev, B43_SHM_SHARED, offset + i,
-				phase1key ? phase1key[i / 2] : 0);
-	}
-	b43_shm_write16(dev, B43_SHM_SHARED, offset + i, iv32);
-	b43_shm_write16(dev, B43_SHM_SHARED, offset + i + 2, iv32 >> 16);
+	for (i = 0; i < 5; i++)
+		words[i] = phase1key ? phase1key[i] : 0;
+	words[5] = iv32;
+	words[6] = iv32 >> 16;
+	b43_shm_write16_burst(dev, offset, words, ARRAY_SIZE(words));
 }
 
 static void b43_op_update_tkip_key(struct ieee80211_hw *hw,
@@ -956,6 +1139,17 @@ static void do_key_write(struct b43_wldev *dev,
 		keymac_write(dev, index, mac_addr);
 
 	dev->key[index].algorithm = algorithm;
+	__set_bit(index, dev->key_dirty);
+}
+
+/* Write an empty key to a slot, unless it is known to be empty already. */
+static void b43_key_clear_slot(struct b43_wldev *dev, int index)
+{
+	if (!test_bit(index, dev->key_dirty))
+		return;
+	do_key_write(dev, index, B43_SEC_ALGO_NONE,
+		     NULL, B43_SEC_KEYSIZE, NULL);
+	__clear_bit(index, dev->key_dirty);
 }
 
 static int b43_key_write(struct b43_wldev *dev,
@@ -964,7 +1158,6 @@ static int b43_key_write(struct b43_wldev *dev,
 			 const u8 *mac_addr,
 			 struct ieee80211_key_conf *keyconf)
 {
-	int i;
 	int pairwise_keys_start;
 
 	/* For ALG_TKIP the key is encoded as a 256-bit (32 byte) data block:
@@ -978,27 +1171,23 @@ static int b43_key_write(struct b43_wldev *dev,
 		key_len = 16;
 	if (key_len > B43_SEC_KEYSIZE)
 		return -EINVAL;
-	for (i = 0; i < ARRAY_SIZE(dev->key); i++) {
-		/* Check that we don't already have this key. */
-		B43_WARN_ON(dev->key[i].keyconf == keyconf);
-	}
+	/* Check that we don't already have this key. A key we own has
+	 * its slot in hw_key_idx. */
+	if (keyconf->hw_key_idx < ARRAY_SIZE(dev->key))
+		B43_WARN_ON(dev->key[keyconf->hw_key_idx].keyconf == keyconf);
 	if (index < 0) {
 		/* Pairwise key. Get an empty slot for the key. */
 		if (b43_new_kidx_api(dev))
 			pairwise_keys_start = B43_NR_GROUP_KEYS;
 		else
 			pairwise_keys_start = B43_NR_GROUP_KEYS * 2;
-		for (i = pairwise_keys_start;
-		     i < pairwise_keys_start + B43_NR_PAIRWISE_KEYS;
-		     i++) {
-			B43_WARN_ON(i >= ARRAY_SIZE(dev->key));
-			if (!dev->key[i].keyconf) {
-				/* found empty */
-				index = i;
-				break;
-			}
-		}
-		if (index < 0) {
+		B43_WARN_ON(pairwise_keys_start + B43_NR_PAIRWISE_KEYS >
+			    ARRAY_SIZE(dev->key));
+		index = find_next_zero_bit(dev->key_used,
+					   pairwise_keys_start +
+					   B43_NR_PAIRWISE_KEYS,
+					   pairwise_keys_start);
+		if (index >= pairwise_keys_start + B43_NR_PAIRWISE_KEYS) {
 			b43warn(dev->wl, "Out of hardware key memory\n");
 			return -ENOSPC;
 		}
@@ -1013,6 +1202,7 @@ static int b43_key_write(struct b43_wldev *dev,
 	}
 	keyconf->hw_key_idx = index;
 	dev->key[index].keyconf = keyconf;
+	__set_bit(index, dev->key_used);
 
 	return 0;
 }
@@ -1021,17 +1211,16 @@ static int b43_key_clear(struct b43_wldev *dev, int index)
 {
 	if (B43_WARN_ON((index < 0) || (index >= ARRAY_SIZE(dev->key))))
 		return -EINVAL;
-	do_key_write(dev, index, B43_SEC_ALGO_NONE,
-		     NULL, B43_SEC_KEYSIZE, NULL);
-	if ((index <= 3) && !b43_new_kidx_api(dev)) {
-		do_key_write(dev, index + 4, B43_SEC_ALGO_NONE,
-			     NULL, B43_SEC_KEYSIZE, NULL);
-	}
+	b43_key_clear_slot(dev, index);
+	if ((index <= 3) && !b43_new_kidx_api(dev))
+		b43_key_clear_slot(dev, index + 4);
 	dev->key[index].keyconf = NULL;
+	__clear_bit(index, dev->key_used);
 
 	return 0;
 }
 
+/* Forget all keys and clear the slots that are not empty in hardware. */
 static void b43_clear_keys(struct b43_wldev *dev)
 {
 	int i, count;
@@ -1040,8 +1229,11 @@ static void b43_clear_keys(struct b43_wldev *dev)
 		count = B43_NR_GROUP_KEYS + B43_NR_PAIRWISE_KEYS;
 	else
 		count = B43_NR_GROUP_KEYS * 2 + B43_NR_PAIRWISE_KEYS;
-	for (i = 0; i < count; i++)
-		b43_key_clear(dev, i);
+	for_each_set_bit(i, dev->key_used, count)
+		dev->key[i].keyconf = NULL;
+	bitmap_zero(dev->key_used, ARRAY_SIZE(dev->key));
+	for_each_set_bit(i, dev->key_dirty, count)
+		b43_key_clear_slot(dev, i);
 }
 
 static void b43_dump_keymemory(struct b43_wldev *dev)
@@ -1261,13 +1453,131 @@ void b43_wireless_core_reset(struct b43_wldev *dev, bool gmode)
 	b43_write32(dev, B43_MMIO_MACCTL, macctl);
 }
 
-static void handle_irq_transmit_status(struct b43_wldev *dev)
+/* TX queue limits.
+ * The number of frames that were handed to the hardware and did not get
+ * a TX status yet is limited per queue with the dynamic queue limits
+ * library, which adapts the limit to the rate of the TX status reports,
+ * the same way BQL does for ethernet drivers. A queue that is over its
+ * limit is stopped, so that frames wait in mac80211 instead of in the
+ * hardware rings, and is woken once a quarter of its limit is free again.
+ * The TX status does not carry the frame length, so the limits count
+ * frames, not bytes.
+ * Without QoS all frames go to the best effort ring. Frames sent after
+ * DTIM go to the multicast ring and are not counted at all.
+ */
+#ifdef CONFIG_BQL
+static struct dql *b43_tx_bql(struct b43_wldev *dev, int queue_num)
 {
+	if (!dev->qos_enabled)
+		queue_num = 2; /* Best effort */
+
+	return &dev->wl->tx_dql[queue_num];
+}
+
+static bool b43_tx_bql_full(struct b43_wldev *dev, int queue_num)
+{
+	return dql_avail(b43_tx_bql(dev, queue_num)) < 0;
+}
+
+static void b43_tx_bql_queued(struct b43_wldev *dev, int queue_num,
+			      bool after_dtim)
+{
+	if (!after_dtim)
+		dql_queued(b43_tx_bql(dev, queue_num), 1);
+}
+
+/* "done" is the number of TX status reports per ring since the last call,
+ * indexed by mac80211 queue number. */
+static void b43_tx_bql_completed(struct b43_wldev *dev,
+				 const unsigned int *done)
+{
+	struct b43_wl *wl = dev->wl;
+	unsigned int pending;
+	bool kick = false;
+	struct dql *dql;
+	int queue_num;
+
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++) {
+		if (!done[queue_num])
+			continue;
+		dql = b43_tx_bql(dev, queue_num);
+		/* Reports for frames that were not counted. */
+		pending = dql->num_queued - dql->num_completed;
+		dql_completed(dql, min(done[queue_num], pending));
+	}
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++) {
+		if (!test_bit(queue_num, &wl->tx_bql_stopped))
+			continue;
+		dql = b43_tx_bql(dev, queue_num);
+		if (dql_avail(dql) < (int)(dql->limit / 4))
+			continue;
+		clear_bit(queue_num, &wl->tx_bql_stopped);
+		/* A full ring is woken by the DMA/PIO layer. */
+		if (!wl->tx_queue_stopped[queue_num])
+			ieee80211_wake_queue(wl->hw, queue_num);
+		kick = true;
+	}
+	if (kick)
+		ieee80211_queue_work(wl->hw, &wl->tx_work);
+}
+
+static void b43_tx_bql_reset(struct b43_wl *wl)
+{
+	int queue_num;
+
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++)
+		dql_reset(&wl->tx_dql[queue_num]);
+	wl->tx_bql_stopped = 0;
+}
+
+static void b43_tx_bql_init(struct b43_wl *wl)
+{
+	int queue_num;
+
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++)
+		dql_init(&wl->tx_dql[queue_num], HZ);
+	wl->tx_bql_stopped = 0;
+}
+#else
+static inline bool b43_tx_bql_full(struct b43_wldev *dev, int queue_num)
+{
+	return false;
+}
+
+static inline void b43_tx_bql_queued(struct b43_wldev *dev, int queue_num,
+				     bool after_dtim)
+{
+}
+
+static inline void b43_tx_bql_completed(struct b43_wldev *dev,
+					const unsigned int *done)
+{
+}
+
+static inline void b43_tx_bql_reset(struct b43_wl *wl)
+{
+}
+
+static inline void b43_tx_bql_init(struct b43_wl *wl)
+{
+}
+#endif /* CONFIG_BQL */
+
+/* Handle at most "budget" TX status reports.
+ * Returns the number of reports handled. */
+static unsigned int handle_irq_transmit_status(struct b43_wldev *dev,
+					       unsigned int budget)
+{
+	unsigned int done[B43_QOS_QUEUE_NUM] = { 0, };
+	unsigned int count = 0;
+	unsigned int ring;
 	u32 v0, v1;
 	u16 tmp;
 	struct b43_txstatus stat;
 
-	while (1) {
+	/* The TX rings are shared with b43_tx_work(). */
+	mutex_lock(&dev->wl->tx_mutex);
+	while (count < budget) {
 		v0 = b43_read32(dev, B43_MMIO_XMITSTAT_0);
 		if (!(v0 & 0x00000001))
 			break;
@@ -1286,7 +1596,19 @@ static void handle_irq_transmit_status(struct b43_wldev *dev)
 		stat.acked = !!(tmp & 0x0002);
 
 		b43_handle_txstatus(dev, &stat);
+		count++;
+
+		/* The upper 4 bits of the cookie are the DMA ring or PIO
+		 * queue number plus 1: BK, BE, VI, VO, multicast. */
+		ring = stat.cookie >> 12;
+		if (!stat.intermediate && !stat.for_ampdu &&
+		    ring >= 1 && ring <= B43_QOS_QUEUE_NUM)
+			done[B43_QOS_QUEUE_NUM - ring]++;
 	}
+	b43_tx_bql_completed(dev, done);
+	mutex_unlock(&dev->wl->tx_mutex);
+
+	return count;
 }
 
 static void drain_txstatus_queue(struct b43_wldev *dev)
@@ -1557,7 +1879,7 @@ static void b43_write_beacon_template(struct b43_wldev *dev,
 	/* Write the PHY TX control parameters. */
 	antenna = B43_ANTENNA_DEFAULT;
 	antenna = b43_antenna_to_phyctl(antenna);
-	ctl = b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_BEACPHYCTL);
+	ctl = b43_shm_shadow_read16(dev, B43_SHADOW_BEACPHYCTL);
 	/* We can't send beacons with short preamble. Would get PHY errors. */
 	ctl &= ~B43_TXH_PHY_SHORTPRMBL;
 	ctl &= ~B43_TXH_PHY_ANT;
@@ -1567,7 +1889,7 @@ static void b43_write_beacon_template(struct b43_wldev *dev,
 		ctl |= B43_TXH_PHY_ENC_CCK;
 	else
 		ctl |= B43_TXH_PHY_ENC_OFDM;
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_BEACPHYCTL, ctl);
+	b43_shm_shadow_write16(dev, B43_SHADOW_BEACPHYCTL, ctl);
 
 	/* Find the position of the TIM and the DTIM_period value
 	 * and write them to SHM. */
@@ -1871,11 +2193,77 @@ out:
 			B43_DEBUGIRQ_REASON_REG, B43_DEBUGIRQ_ACK);
 }
 
+/* Budgeted polling.
+ * The interrupt thread handles at most "pollbudget" TX status reports.
+ * If it used up the budget, there is probably more work, so the TX status
+ * and DMA interrupts are masked and the rest is handled by
+ * b43_irq_poll_work(), one budget per run, with wl->mutex released in
+ * between so that other work gets a chance to run. Received frames do not
+ * raise an interrupt while it is masked, so every poll also runs the RX
+ * ring. All other interrupt reasons (beacon, TBTT, PMQ, PHY errors, ...)
+ * stay enabled and are handled by the interrupt thread as usual. The full
+ * mask is restored once a poll finds less work than its budget.
+ */
+#define B43_IRQ_POLLED		(B43_IRQ_TX_OK | B43_IRQ_DMA)
+
+static unsigned int b43_poll_budget(void)
+{
+	return max(modparam_pollbudget, 1);
+}
+
+static void b43_irq_poll_done(struct b43_wldev *dev, unsigned int txstatus,
+			      unsigned int budget)
+{
+#if B43_DEBUG
+	dev->poll_count++;
+	dev->poll_txstatus_count += txstatus;
+#endif
+	if (txstatus >= budget) {
+#if B43_DEBUG
+		dev->repoll_count++;
+#endif
+		ieee80211_queue_work(dev->wl->hw, &dev->irq_poll_work);
+		/* The hardirq handler disabled all interrupts. Enable those
+		 * that the poll does not handle. If the interrupt thread
+		 * restores the full mask in the meantime, the queued poll
+		 * masks the polled reasons again when it finds more work. */
+		b43_write32(dev, B43_MMIO_GEN_IRQ_MASK,
+			    dev->irq_mask & ~B43_IRQ_POLLED);
+		return;
+	}
+	/* Re-enable interrupts on the device by restoring the current interrupt mask. */
+	b43_write32(dev, B43_MMIO_GEN_IRQ_MASK, dev->irq_mask);
+}
+
+static void b43_irq_poll_work(struct work_struct *work)
+{
+	struct b43_wldev *dev = container_of(work, struct b43_wldev,
+					     irq_poll_work);
+	struct b43_wl *wl = dev->wl;
+	unsigned int budget = b43_poll_budget();
+	unsigned int txstatus;
+
+	mutex_lock(&wl->mutex);
+	if (unlikely(b43_status(dev) != B43_STAT_STARTED))
+		goto out;
+	if (b43_using_pio_transfers(dev))
+		b43_pio_rx(dev->pio.rx_queue);
+	else
+		b43_dma_rx(dev->dma.rx_ring);
+	txstatus = handle_irq_transmit_status(dev, budget);
+	b43_irq_poll_done(dev, txstatus, budget);
+	mmiowb();
+out:
+	mutex_unlock(&wl->mutex);
+}
+
 static void b43_do_interrupt_thread(struct b43_wldev *dev)
 {
 	u32 reason;
 	u32 dma_reason[ARRAY_SIZE(dev->dma_reason)];
 	u32 merged_dma_reason = 0;
+	unsigned int budget = b43_poll_budget();
+	unsigned int txstatus = 0;
 	int i;
 
 	if (unlikely(b43_status(dev) != B43_STAT_STARTED))
@@ -1950,10 +2338,9 @@ static void b43_do_interrupt_thread(struct b43_wldev *dev)
 	B43_WARN_ON(dma_reason[5] & B43_DMAIRQ_RX_DONE);
 
 	if (reason & B43_IRQ_TX_OK)
-		handle_irq_transmit_status(dev);
+		txstatus = handle_irq_transmit_status(dev, budget);
 
-	/* Re-enable interrupts on the device by restoring the current interrupt mask. */
-	b43_write32(dev, B43_MMIO_GEN_IRQ_MASK, dev->irq_mask);
+	b43_irq_poll_done(dev, txstatus, budget);
 
 #if B43_DEBUG
 	if (b43_debug(dev, B43_DBG_VERBOSESTATS)) {
@@ -2059,19 +2446,205 @@ static void b43_sdio_interrupt_handler(struct b43_wldev *dev)
 	mutex_unlock(&wl->mutex);
 }
 
-void b43_do_release_fw(struct b43_firmware_file *fw)
+/* Initvals write program.
+ * The initvals files are a list of big-endian (offset, value) records of
+ * variable size. They are checked and converted once, when the file is
+ * taken into the firmware cache, into a native-endian list of writes
+ * that every core init just replays. Two 16-bit writes to the halves of
+ * a register, one right after the other, become a single 32-bit write,
+ * but only for the registers in b43_iv_mergeable(). Most of the core
+ * registers are 16-bit only, and for the indirect ones (PHY and radio
+ * control/data, SHM control/data) the access width and order are part
+ * of the protocol.
+ */
+struct b43_iv_op {
+	u32 value;
+	u16 offset;
+	bool bit32;
+};
+
+struct b43_iv_prog {
+	size_t count;
+	struct b43_iv_op ops[0];
+};
+
+/* The plain data registers that the driver itself writes with 32-bit
+ * accesses (see b43_set_beacon_int()). */
+static bool b43_iv_mergeable(u16 offset)
+{
+	switch (offset) {
+	case B43_MMIO_TSF_CFP_REP:
+	case B43_MMIO_TSF_CFP_START:
+		return true;
+	}
+
+	return false;
+}
+
+static struct b43_iv_prog *b43_compile_initvals(const struct firmware *blob)
+{
+	const size_t hdr_len = sizeof(struct b43_fw_header);
+	const struct b43_fw_header *hdr;
+	const struct b43_iv *iv;
+	struct b43_iv_prog *prog;
+	struct b43_iv_op *op, *prev = NULL;
+	size_t array_size, count, i;
+	u16 offset;
+	bool bit32;
+
+	BUILD_BUG_ON(sizeof(struct b43_iv) != 6);
+	hdr = (const struct b43_fw_header *)(blob->data);
+	count = be32_to_cpu(hdr->size);
+	array_size = blob->size - hdr_len;
+	/* Every record has at least an offset and a 16-bit value. */
+	if (count > array_size / (sizeof(__be16) + sizeof(__be16)))
+		return ERR_PTR(-EPROTO);
+	prog = kmalloc(sizeof(*prog) + count * sizeof(prog->ops[0]),
+		       GFP_KERNEL);
+	if (!prog)
+		return ERR_PTR(-ENOMEM);
+	prog->count = 0;
+
+	iv = (const struct b43_iv *)(blob->data + hdr_len);
+	for (i = 0; i < count; i++) {
+		if (array_size < sizeof(iv->offset_size))
+			goto err_format;
+		array_size -= sizeof(iv->offset_size);
+		offset = be16_to_cpu(iv->offset_size);
+		bit32 = !!(offset & B43_IV_32BIT);
+		offset &= B43_IV_OFFSET_MASK;
+		if (offset >= 0x1000)
+			goto err_format;
+		if (bit32) {
+			if (array_size < sizeof(iv->data.d32))
+				goto err_format;
+			array_size -= sizeof(iv->data.d32);
+
+			op = &prog->ops[prog->count++];
+			op->offset = offset;
+			op->bit32 = true;
+			op->value = get_unaligned_be32(&iv->data.d32);
+			prev = NULL;
+
+			iv = (const struct b43_iv *)((const uint8_t *)iv +
+							sizeof(__be16) +
+							sizeof(__be32));
+		} else {
+			u16 value;
+
+			if (array_size < sizeof(iv->data.d16))
+				goto err_format;
+			array_size -= sizeof(iv->data.d16);
+			value = be16_to_cpu(iv->data.d16);
+
+			if (prev && offset == prev->offset + 2) {
+				/* Upper half of the previous write. */
+				prev->bit32 = true;
+				prev->value |= (u32)value << 16;
+				prev = NULL;
+			} else {
+				op = &prog->ops[prog->count++];
+				op->offset = offset;
+				op->bit32 = false;
+				op->value = value;
+				prev = b43_iv_mergeable(offset) ? op : NULL;
+			}
+
+			iv = (const struct b43_iv *)((const uint8_t *)iv +
+							sizeof(__be16) +
+							sizeof(__be16));
+		}
+	}
+	if (array_size)
+		goto err_format;
+
+	return prog;
+
+err_format:
+	kfree(prog);
+
+	return ERR_PTR(-EPROTO);
+}
+
+/* Firmware cache.
+ * Every firmware file that was requested and validated is kept in a
+ * per-device cache until the device is detached, so that a file that is
+ * needed again (for another band, after a restart or when falling back
+ * from one firmware type to the other) is never requested twice.
+ * The b43_firmware_file structs in dev->fw only point into the cache.
+ */
+static const struct firmware *b43_fw_cache_lookup(struct b43_wldev *dev,
+					enum b43_firmware_file_type type,
+					const char *name)
+{
+	struct b43_fw_cache_entry *entry;
+
+	list_for_each_entry(entry, &dev->fw.cache, list) {
+		if (entry->type == type && strcmp(entry->name, name) == 0)
+			return entry->data;
+	}
+
+	return NULL;
+}
+
+/* Returns the write program of a cached initvals file. */
+static const struct b43_iv_prog *b43_fw_cache_ivprog(struct b43_wldev *dev,
+					const struct firmware *data)
+{
+	struct b43_fw_cache_entry *entry;
+
+	list_for_each_entry(entry, &dev->fw.cache, list) {
+		if (entry->data == data)
+			return entry->ivprog;
+	}
+
+	return NULL;
+}
+
+static int b43_fw_cache_add(struct b43_wldev *dev,
+			    enum b43_firmware_file_type type,
+			    const char *name, const struct firmware *data,
+			    struct b43_iv_prog *ivprog)
+{
+	struct b43_fw_cache_entry *entry;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return -ENOMEM;
+	entry->type = type;
+	entry->name = name;
+	entry->data = data;
+	entry->ivprog = ivprog;
+	list_add(&entry->list, &dev->fw.cache);
+
+	return 0;
+}
+
+static void b43_fw_cache_flush(struct b43_wldev *dev)
+{
+	struct b43_fw_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &dev->fw.cache, list) {
+		list_del(&entry->list);
+		release_firmware(entry->data);
+		kfree(entry->ivprog);
+		kfree(entry);
+	}
+}
+
+static void b43_forget_fw(struct b43_firmware_file *fw)
 {
-	release_firmware(fw->data);
 	fw->data = NULL;
 	fw->filename = NULL;
 }
 
 static void b43_release_firmware(struct b43_wldev *dev)
 {
-	b43_do_release_fw(&dev->fw.ucode);
-	b43_do_release_fw(&dev->fw.pcm);
-	b43_do_release_fw(&dev->fw.initvals);
-	b43_do_release_fw(&dev->fw.initvals_band);
+	b43_forget_fw(&dev->fw.ucode);
+	b43_forget_fw(&dev->fw.pcm);
+	b43_forget_fw(&dev->fw.initvals);
+	b43_forget_fw(&dev->fw.initvals_band);
+	b43_fw_cache_flush(dev);
 }
 
 static void b43_print_fw_helptext(struct b43_wl *wl, bool error)
@@ -2088,98 +2661,104 @@ static void b43_print_fw_helptext(struct b43_wl *wl, bool error)
 		b43warn(wl, text);
 }
 
-static void b43_fw_cb(const struct firmware *firmware, void *context)
+/* Use the file already in "fw" or in the firmware cache, if any. */
+static bool b43_fw_use_cached(struct b43_request_fw_context *ctx,
+			      const char *name, struct b43_firmware_file *fw)
 {
-	struct b43_request_fw_context *ctx = context;
+	const struct firmware *cached;
 
-	ctx->blob = firmware;
-	complete(&ctx->fw_load_complete);
-}
-
-int b43_do_request_fw(struct b43_request_fw_context *ctx,
-		      const char *name,
-		      struct b43_firmware_file *fw, bool async)
-{
-	struct b43_fw_header *hdr;
-	u32 size;
-	int err;
-
-	if (!name) {
-		/* Don't fetch anything. Free possibly cached firmware. */
-		/* FIXME: We should probably keep it anyway, to save some headache
-		 * on suspend/resume with multiband devices. */
-		b43_do_release_fw(fw);
-		return 0;
-	}
 	if (fw->filename) {
 		if ((fw->type == ctx->req_type) &&
 		    (strcmp(fw->filename, name) == 0))
-			return 0; /* Already have this fw. */
-		/* Free the cached firmware first. */
-		/* FIXME: We should probably do this later after we successfully
-		 * got the new fw. This could reduce headache with multiband devices.
-		 * We could also redesign this to cache the firmware for all possible
-		 * bands all the time. */
-		b43_do_release_fw(fw);
+			return true; /* Already have this fw. */
 	}
+	cached = b43_fw_cache_lookup(ctx->dev, ctx->req_type, name);
+	if (!cached)
+		return false;
+	/* Requested and validated before. */
+	fw->data = cached;
+	fw->filename = name;
+	fw->type = ctx->req_type;
+
+	return true;
+}
 
+static int b43_fw_path(struct b43_request_fw_context *ctx, const char *name,
+		       char *path, size_t size)
+{
 	switch (ctx->req_type) {
 	case B43_FWTYPE_PROPRIETARY:
-		snprintf(ctx->fwname, sizeof(ctx->fwname),
-			 "b43%s/%s.fw",
-			 modparam_fwpostfix, name);
+		snprintf(path, size, "b43%s/%s.fw", modparam_fwpostfix, name);
 		break;
 	case B43_FWTYPE_OPENSOURCE:
-		snprintf(ctx->fwname, sizeof(ctx->fwname),
-			 "b43-open%s/%s.fw",
+		snprintf(path, size, "b43-open%s/%s.fw",
 			 modparam_fwpostfix, name);
 		break;
 	default:
 		B43_WARN_ON(1);
 		return -ENOSYS;
 	}
-	if (async) {
-		/* do this part asynchronously */
-		init_completion(&ctx->fw_load_complete);
-		err = request_firmware_nowait(THIS_MODULE, 1, ctx->fwname,
-					      ctx->dev->dev->dev, GFP_KERNEL,
-					      ctx, b43_fw_cb);
-		if (err < 0) {
-			pr_err("Unable to load firmware\n");
-			return err;
-		}
-		/* stall here until fw ready */
-		wait_for_completion(&ctx->fw_load_complete);
-		if (ctx->blob)
-			goto fw_ready;
-	/* On some ARM systems, the async request will fail, but the next sync
-	 * request works. For this reason, we dall through here
-	 */
-	}
-	err = request_firmware(&ctx->blob, ctx->fwname,
-			       ctx->dev->dev->dev);
+
+	return 0;
+}
+
+/* The firmware loader calls, so that the tests can use a stand-in. */
+struct b43_fw_loader {
+	int (*request)(const struct firmware **fw, const char *name,
+		       struct device *device);
+	int (*request_nowait)(struct module *module, bool uevent,
+			      const char *name, struct device *device,
+			      gfp_t gfp, void *context,
+			      void (*cont)(const struct firmware *fw,
+					   void *context));
+};
+
+static const struct b43_fw_loader b43_fw_loader = {
+	.request	= request_firmware,
+	.request_nowait	= request_firmware_nowait,
+};
+
+static int b43_fw_request_sync(struct b43_request_fw_context *ctx,
+			       const struct b43_fw_loader *loader,
+			       const char *path, const struct firmware **blob)
+{
+	int err;
+
+	err = loader->request(blob, path, ctx->dev->dev->dev);
 	if (err == -ENOENT) {
 		snprintf(ctx->errors[ctx->req_type],
 			 sizeof(ctx->errors[ctx->req_type]),
-			 "Firmware file \"%s\" not found\n",
-			 ctx->fwname);
-		return err;
+			 "Firmware file \"%s\" not found\n", path);
 	} else if (err) {
 		snprintf(ctx->errors[ctx->req_type],
 			 sizeof(ctx->errors[ctx->req_type]),
 			 "Firmware file \"%s\" request failed (err=%d)\n",
-			 ctx->fwname, err);
-		return err;
+			 path, err);
 	}
-fw_ready:
-	if (ctx->blob->size < sizeof(struct b43_fw_header))
+
+	return err;
+}
+
+/* Check the header of a firmware file that was just loaded and put the
+ * file into the cache. The file is released on error. */
+static int b43_fw_accept(struct b43_request_fw_context *ctx,
+			 const char *name, const char *path,
+			 const struct firmware *blob,
+			 struct b43_firmware_file *fw)
+{
+	struct b43_iv_prog *ivprog = NULL;
+	struct b43_fw_header *hdr;
+	u32 size;
+	int err;
+
+	if (blob->size < sizeof(struct b43_fw_header))
 		goto err_format;
-	hdr = (struct b43_fw_header *)(ctx->blob->data);
+	hdr = (struct b43_fw_header *)(blob->data);
 	switch (hdr->type) {
 	case B43_FW_TYPE_UCODE:
 	case B43_FW_TYPE_PCM:
 		size = be32_to_cpu(hdr->size);
-		if (size != ctx->blob->size - sizeof(struct b43_fw_header))
+		if (size != blob->size - sizeof(struct b43_fw_header))
 			goto err_format;
 		/* fallthrough */
 	case B43_FW_TYPE_IV:
@@ -2189,8 +2768,25 @@ fw_ready:
 	default:
 		goto err_format;
 	}
+	if (hdr->type == B43_FW_TYPE_IV) {
+		ivprog = b43_compile_initvals(blob);
+		if (IS_ERR(ivprog)) {
+			err = PTR_ERR(ivprog);
+			if (err == -EPROTO)
+				goto err_format;
+			release_firmware(blob);
+			return err;
+		}
+	}
 
-	fw->data = ctx->blob;
+	err = b43_fw_cache_add(ctx->dev, ctx->req_type, name, blob, ivprog);
+	if (err) {
+		kfree(ivprog);
+		release_firmware(blob);
+		return err;
+	}
+	/* The file used before, if any, stays in the cache. */
+	fw->data = blob;
 	fw->filename = name;
 	fw->type = ctx->req_type;
 
@@ -2199,17 +2795,112 @@ fw_ready:
 err_format:
 	snprintf(ctx->errors[ctx->req_type],
 		 sizeof(ctx->errors[ctx->req_type]),
-		 "Firmware file \"%s\" format error.\n", ctx->fwname);
-	release_firmware(ctx->blob);
+		 "Firmware file \"%s\" format error.\n", path);
+	release_firmware(blob);
 
 	return -EPROTO;
 }
 
+/* One of the firmware files requested by b43_request_fw_files(). */
+struct b43_fw_request {
+	const char *name;
+	struct b43_firmware_file *fw;
+	/* A missing file (-ENOENT) is not an error. */
+	bool optional;
+
+	bool load;
+	bool pending;
+	char path[64];
+	const struct firmware *blob;
+	struct completion done;
+	int err;
+};
+
+static void b43_fw_request_cb(const struct firmware *firmware, void *context)
+{
+	struct b43_fw_request *req = context;
+
+	req->blob = firmware;
+	complete(&req->done);
+}
+
+/* Request all the files in "reqs" at the same time and wait once for all
+ * of them, instead of waiting for each file in turn. The files are then
+ * checked in array order, as if they were requested one after the
+ * other: req->err is the result for each file and ctx->errors holds the
+ * message of the failure. Returns the error of the first file that
+ * failed; the files that follow it are dropped. */
+static int b43_request_fw_files(struct b43_request_fw_context *ctx,
+				const struct b43_fw_loader *loader,
+				struct b43_fw_request *reqs,
+				unsigned int count)
+{
+	struct b43_fw_request *req;
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < count; i++) {
+		req = &reqs[i];
+		req->load = false;
+		req->pending = false;
+		req->blob = NULL;
+		req->err = 0;
+		if (!req->name) {
+			b43_forget_fw(req->fw);
+			continue;
+		}
+		if (b43_fw_use_cached(ctx, req->name, req->fw))
+			continue;
+		req->load = true;
+		req->err = b43_fw_path(ctx, req->name, req->path,
+				       sizeof(req->path));
+		if (req->err)
+			continue;
+		init_completion(&req->done);
+		if (loader->request_nowait(THIS_MODULE, 1, req->path,
+					   ctx->dev->dev->dev, GFP_KERNEL,
+					   req, b43_fw_request_cb) >= 0)
+			req->pending = true;
+	}
+	for (i = 0; i < count; i++) {
+		if (reqs[i].pending)
+			wait_for_completion(&reqs[i].done);
+	}
+
+	for (i = 0; i < count; i++) {
+		req = &reqs[i];
+		if (!req->load)
+			continue;
+		if (err) {
+			release_firmware(req->blob);
+			continue;
+		}
+		/* On some ARM systems the async request fails, but
+		 * the sync one works. */
+		if (!req->err && !req->blob)
+			req->err = b43_fw_request_sync(ctx, loader, req->path,
+						       &req->blob);
+		if (!req->err)
+			req->err = b43_fw_accept(ctx, req->name, req->path,
+						 req->blob, req->fw);
+		if (req->err && !(req->optional && req->err == -ENOENT))
+			err = req->err;
+	}
+
+	return err;
+}
+
 static int b43_try_request_fw(struct b43_request_fw_context *ctx)
 {
 	struct b43_wldev *dev = ctx->dev;
 	struct b43_firmware *fw = &ctx->dev->fw;
 	const u8 rev = ctx->dev->dev->core_rev;
+	struct b43_fw_request reqs[] = {
+		{ .fw = &fw->ucode, },
+		{ .fw = &fw->pcm, .optional = true, },
+		{ .fw = &fw->initvals, },
+		{ .fw = &fw->initvals_band, },
+	};
 	const char *filename;
 	u32 tmshigh;
 	int err;
@@ -2251,9 +2942,7 @@ static int b43_try_request_fw(struct b43_request_fw_context *ctx)
 			goto err_no_ucode;
 		}
 	}
-	err = b43_do_request_fw(ctx, filename, &fw->ucode, true);
-	if (err)
-		goto err_load;
+	reqs[0].name = filename;
 
 	/* Get PCM code */
 	if ((rev >= 5) && (rev <= 10))
@@ -2262,14 +2951,7 @@ static int b43_try_request_fw(struct b43_request_fw_context *ctx)
 		filename = NULL;
 	else
 		goto err_no_pcm;
-	fw->pcm_request_failed = false;
-	err = b43_do_request_fw(ctx, filename, &fw->pcm, false);
-	if (err == -ENOENT) {
-		/* We did not find a PCM file? Not fatal, but
-		 * core rev <= 10 must do without hwcrypto then. */
-		fw->pcm_request_failed = true;
-	} else if (err)
-		goto err_load;
+	reqs[1].name = filename;
 
 	/* Get initvals */
 	switch (dev->phy.type) {
@@ -2324,9 +3006,7 @@ static int b43_try_request_fw(struct b43_request_fw_context *ctx)
 	default:
 		goto err_no_initvals;
 	}
-	err = b43_do_request_fw(ctx, filename, &fw->initvals, false);
-	if (err)
-		goto err_load;
+	reqs[2].name = filename;
 
 	/* Get bandswitch initvals */
 	switch (dev->phy.type) {
@@ -2383,7 +3063,14 @@ static int b43_try_request_fw(struct b43_request_fw_context *ctx)
 	default:
 		goto err_no_initvals;
 	}
-	err = b43_do_request_fw(ctx, filename, &fw->initvals_band, false);
+	reqs[3].name = filename;
+
+	/* All the files are requested at the same time. */
+	err = b43_request_fw_files(ctx, &b43_fw_loader,
+				   reqs, ARRAY_SIZE(reqs));
+	/* We did not find a PCM file? Not fatal, but
+	 * core rev <= 10 must do without hwcrypto then. */
+	fw->pcm_request_failed = (reqs[1].err == -ENOENT);
 	if (err)
 		goto err_load;
 
@@ -2482,6 +3169,69 @@ out:
 	kfree(ctx);
 }
 
+/* Zero out all microcode PSM registers and shared memory.
+ * The PSM registers are 16bit wide, and only 32bit data writes are
+ * known to advance an auto-incrementing address, so they are written
+ * one by one. The shared memory is cleared with a single 32bit burst. */
+static void b43_ucode_clear_memory(struct b43_wldev *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < 64; i++)
+		b43_shm_write16(dev, B43_SHM_SCRATCH, i, 0);
+	b43_shm_clear_bulk(dev, B43_SHM_SHARED, 0, 4096 / sizeof(u32));
+	b43_shm_shadow_invalidate(dev);
+	/* The key slots no longer hold what we wrote last. */
+	bitmap_fill(dev->key_dirty, ARRAY_SIZE(dev->key));
+}
+
+/* Upload the microcode with a delay after every word.
+ * This is the conservative path, used by slow buses and as the fallback
+ * of b43_upload_ucode_verified(). */
+static void b43_upload_ucode_paced(struct b43_wldev *dev,
+				   const __be32 *data, unsigned int len)
+{
+	unsigned int i;
+
+	b43_shm_control_word(dev, B43_SHM_UCODE | B43_SHM_AUTOINC_W, 0x0000);
+	for (i = 0; i < len; i++) {
+		b43_write32(dev, B43_MMIO_SHM_DATA, be32_to_cpu(data[i]));
+		udelay(10);
+	}
+}
+
+/* Upload the microcode as a single burst and read it back.
+ * Returns -EIO if the image read back differs from the firmware file. */
+static int b43_upload_ucode_verified(struct b43_wldev *dev,
+				     const __be32 *data, unsigned int len)
+{
+	unsigned int i;
+
+	b43_shm_write_bulk(dev, B43_SHM_UCODE, 0x0000, data, len);
+
+	b43_shm_control_word(dev, B43_SHM_UCODE | B43_SHM_AUTOINC_R, 0x0000);
+	for (i = 0; i < len; i++) {
+		if (b43_read32(dev, B43_MMIO_SHM_DATA) != be32_to_cpu(data[i])) {
+			b43dbg(dev->wl, "Microcode readback mismatch at word %u\n",
+			       i);
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/* The per-word delay only matters on fast buses; on SDIO and PCMCIA every
+ * access already takes longer and a readback would cost more than the
+ * delays it saves. */
+static bool b43_ucode_upload_fast(struct b43_wldev *dev)
+{
+	if (!modparam_fastfwupload || dev->fw.upload_paced)
+		return false;
+	return !b43_bus_host_is_sdio(dev->dev) &&
+	       !b43_bus_host_is_pcmcia(dev->dev);
+}
+
 static int b43_upload_microcode(struct b43_wldev *dev)
 {
 	struct wiphy *wiphy = dev->wl->hw->wiphy;
@@ -2497,19 +3247,19 @@ static int b43_upload_microcode(struct b43_wldev *dev)
 	B43_WARN_ON(macctl & B43_MACCTL_PSM_RUN);
 	macctl |= B43_MACCTL_PSM_JMP0;
 	b43_write32(dev, B43_MMIO_MACCTL, macctl);
-	/* Zero out all microcode PSM registers and shared memory. */
-	for (i = 0; i < 64; i++)
-		b43_shm_write16(dev, B43_SHM_SCRATCH, i, 0);
-	for (i = 0; i < 4096; i += 2)
-		b43_shm_write16(dev, B43_SHM_SHARED, i, 0);
+	b43_ucode_clear_memory(dev);
 
 	/* Upload Microcode. */
 	data = (__be32 *) (dev->fw.ucode.data->data + hdr_len);
 	len = (dev->fw.ucode.data->size - hdr_len) / sizeof(__be32);
-	b43_shm_control_word(dev, B43_SHM_UCODE | B43_SHM_AUTOINC_W, 0x0000);
-	for (i = 0; i < len; i++) {
-		b43_write32(dev, B43_MMIO_SHM_DATA, be32_to_cpu(data[i]));
-		udelay(10);
+	if (!b43_ucode_upload_fast(dev)) {
+		b43_upload_ucode_paced(dev, data, len);
+	} else if (b43_upload_ucode_verified(dev, data, len)) {
+		b43warn(dev->wl, "Fast microcode upload failed, "
+			"falling back to paced upload\n");
+		/* Don't try again on this device. */
+		dev->fw.upload_paced = true;
+		b43_upload_ucode_paced(dev, data, len);
 	}
 
 	if (dev->fw.pcm.data) {
@@ -2629,95 +3379,41 @@ error:
 	return err;
 }
 
-static int b43_write_initvals(struct b43_wldev *dev,
-			      const struct b43_iv *ivals,
-			      size_t count,
-			      size_t array_size)
+static void b43_write_initvals(struct b43_wldev *dev,
+			       const struct b43_iv_prog *prog)
 {
-	const struct b43_iv *iv;
-	u16 offset;
+	const struct b43_iv_op *op;
 	size_t i;
-	bool bit32;
-
-	BUILD_BUG_ON(sizeof(struct b43_iv) != 6);
-	iv = ivals;
-	for (i = 0; i < count; i++) {
-		if (array_size < sizeof(iv->offset_size))
-			goto err_format;
-		array_size -= sizeof(iv->offset_size);
-		offset = be16_to_cpu(iv->offset_size);
-		bit32 = !!(offset & B43_IV_32BIT);
-		offset &= B43_IV_OFFSET_MASK;
-		if (offset >= 0x1000)
-			goto err_format;
-		if (bit32) {
-			u32 value;
-
-			if (array_size < sizeof(iv->data.d32))
-				goto err_format;
-			array_size -= sizeof(iv->data.d32);
-
-			value = get_unaligned_be32(&iv->data.d32);
-			b43_write32(dev, offset, value);
-
-			iv = (const struct b43_iv *)((const uint8_t *)iv +
-							sizeof(__be16) +
-							sizeof(__be32));
-		} else {
-			u16 value;
-
-			if (array_size < sizeof(iv->data.d16))
-				goto err_format;
-			array_size -= sizeof(iv->data.d16);
 
-			value = be16_to_cpu(iv->data.d16);
-			b43_write16(dev, offset, value);
-
-			iv = (const struct b43_iv *)((const uint8_t *)iv +
-							sizeof(__be16) +
-							sizeof(__be16));
-		}
+	for (i = 0; i < prog->count; i++) {
+		op = &prog->ops[i];
+		if (op->bit32)
+			b43_write32(dev, op->offset, op->value);
+		else
+			b43_write16(dev, op->offset, op->value);
 	}
-	if (array_size)
-		goto err_format;
-
-	return 0;
-
-err_format:
-	b43err(dev->wl, "Initial Values Firmware file-format error.\n");
-	b43_print_fw_helptext(dev->wl, 1);
-
-	return -EPROTO;
 }
 
 static int b43_upload_initvals(struct b43_wldev *dev)
 {
-	const size_t hdr_len = sizeof(struct b43_fw_header);
-	const struct b43_fw_header *hdr;
 	struct b43_firmware *fw = &dev->fw;
-	const struct b43_iv *ivals;
-	size_t count;
-	int err;
-
-	hdr = (const struct b43_fw_header *)(fw->initvals.data->data);
-	ivals = (const struct b43_iv *)(fw->initvals.data->data + hdr_len);
-	count = be32_to_cpu(hdr->size);
-	err = b43_write_initvals(dev, ivals, count,
-				 fw->initvals.data->size - hdr_len);
-	if (err)
-		goto out;
+	const struct b43_iv_prog *prog;
+
+	/* Initvals may write to the shared memory. */
+	b43_shm_shadow_invalidate(dev);
+	/* The files were checked when they got into the cache. */
+	prog = b43_fw_cache_ivprog(dev, fw->initvals.data);
+	if (B43_WARN_ON(!prog))
+		return -EPROTO;
+	b43_write_initvals(dev, prog);
 	if (fw->initvals_band.data) {
-		hdr = (const struct b43_fw_header *)(fw->initvals_band.data->data);
-		ivals = (const struct b43_iv *)(fw->initvals_band.data->data + hdr_len);
-		count = be32_to_cpu(hdr->size);
-		err = b43_write_initvals(dev, ivals, count,
-					 fw->initvals_band.data->size - hdr_len);
-		if (err)
-			goto out;
+		prog = b43_fw_cache_ivprog(dev, fw->initvals_band.data);
+		if (B43_WARN_ON(!prog))
+			return -EPROTO;
+		b43_write_initvals(dev, prog);
 	}
-out:
 
-	return err;
+	return 0;
 }
 
 /* Initialize the GPIOs
@@ -3019,9 +3715,9 @@ static void b43_set_phytxctl_defaults(struct b43_wldev *dev)
 	ctl |= B43_TXH_PHY_ANT01AUTO;
 	ctl |= B43_TXH_PHY_TXPWR;
 
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_BEACPHYCTL, ctl);
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_ACKCTSPHYCTL, ctl);
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_PRPHYCTL, ctl);
+	b43_shm_shadow_write16(dev, B43_SHADOW_BEACPHYCTL, ctl);
+	b43_shm_shadow_write16(dev, B43_SHADOW_ACKCTSPHYCTL, ctl);
+	b43_shm_shadow_write16(dev, B43_SHADOW_PRPHYCTL, ctl);
 }
 
 /* Set the TX-Antenna for management frames sent by firmware. */
@@ -3033,13 +3729,13 @@ static void b43_mgmtframe_txantenna(struct b43_wldev *dev, int antenna)
 	ant = b43_antenna_to_phyctl(antenna);
 
 	/* For ACK/CTS */
-	tmp = b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_ACKCTSPHYCTL);
+	tmp = b43_shm_shadow_read16(dev, B43_SHADOW_ACKCTSPHYCTL);
 	tmp = (tmp & ~B43_TXH_PHY_ANT) | ant;
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_ACKCTSPHYCTL, tmp);
+	b43_shm_shadow_write16(dev, B43_SHADOW_ACKCTSPHYCTL, tmp);
 	/* For Probe Resposes */
-	tmp = b43_shm_read16(dev, B43_SHM_SHARED, B43_SHM_SH_PRPHYCTL);
+	tmp = b43_shm_shadow_read16(dev, B43_SHADOW_PRPHYCTL);
 	tmp = (tmp & ~B43_TXH_PHY_ANT) | ant;
-	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_PRPHYCTL, tmp);
+	b43_shm_shadow_write16(dev, B43_SHADOW_PRPHYCTL, tmp);
 }
 
 /* This is the opposite of b43_chip_init() */
@@ -3056,6 +3752,7 @@ static void b43_chip_exit(struct b43_wldev *dev)
 static int b43_chip_init(struct b43_wldev *dev)
 {
 	struct b43_phy *phy = &dev->phy;
+	struct b43_bringup_phase phase;
 	int err;
 	u32 macctl;
 	u16 value16;
@@ -3067,17 +3764,21 @@ static int b43_chip_init(struct b43_wldev *dev)
 	macctl |= B43_MACCTL_INFRA;
 	b43_write32(dev, B43_MMIO_MACCTL, macctl);
 
+	b43_bringup_phase_begin(dev, &phase, "Microcode upload");
 	err = b43_upload_microcode(dev);
 	if (err)
 		goto out;	/* firmware is released later */
+	b43_bringup_phase_end(dev, &phase);
 
 	err = b43_gpio_init(dev);
 	if (err)
 		goto out;	/* firmware is released later */
 
+	b43_bringup_phase_begin(dev, &phase, "Initvals upload");
 	err = b43_upload_initvals(dev);
 	if (err)
 		goto err_gpio_clean;
+	b43_bringup_phase_end(dev, &phase);
 
 	/* Turn the Analog on and initialize the PHY. */
 	phy->ops->switch_analog(dev, 1);
@@ -3174,6 +3875,86 @@ static void b43_periodic_every30sec(struct b43_wldev *dev)
 	b43_calculate_link_quality(dev);
 }
 
+#if B43_DEBUG
+/* The queueing delay statistics keep the time a frame was queued by
+ * b43_op_tx() in the headroom that the driver reserves for it with
+ * hw->extra_tx_headroom, right before skb->data. Nothing else uses that
+ * headroom: the TX header is built in a separate buffer by the DMA and
+ * PIO layers. */
+#define B43_TX_STAMP_HEADROOM	sizeof(ktime_t)
+
+static void b43_tx_stamp(struct sk_buff *skb)
+{
+	ktime_t now = ktime_get();
+
+	if (skb_headroom(skb) >= sizeof(now))
+		memcpy(skb->data - sizeof(now), &now, sizeof(now));
+}
+
+/* The time stored by b43_tx_stamp(), or zero if there is none. It must
+ * be read before the frame is handed to the hardware: the frame may be
+ * completed and freed right after that. */
+static ktime_t b43_tx_get_stamp(struct sk_buff *skb)
+{
+	ktime_t stamp = ktime_set(0, 0);
+
+	if (skb_headroom(skb) >= sizeof(stamp))
+		memcpy(&stamp, skb->data - sizeof(stamp), sizeof(stamp));
+
+	return stamp;
+}
+
+/* Account the queueing delay of a frame that was handed to the hardware. */
+static void b43_tx_account_wait(struct b43_wl *wl, int queue_num,
+				ktime_t stamp)
+{
+	struct b43_txq_stats *stats = &wl->tx_stats[queue_num];
+	u64 wait;
+
+	if (!ktime_to_ns(stamp))
+		return;
+	wait = ktime_to_ns(ktime_sub(ktime_get(), stamp));
+	stats->frames++;
+	stats->wait_ns += wait;
+	stats->wait_max_ns = max(stats->wait_max_ns, wait);
+}
+
+static void b43_tx_print_stats(struct b43_wldev *dev, unsigned int seconds)
+{
+	struct b43_wl *wl = dev->wl;
+	struct b43_txq_stats *stats;
+	unsigned int i;
+
+	for (i = 0; i < B43_QOS_QUEUE_NUM; i++) {
+		stats = &wl->tx_stats[i];
+		if (!stats->frames)
+			continue;
+		b43dbg(wl, "Stats: TX queue %u: %7u frames/sec, "
+		       "wait avg %llu us, max %llu us\n", i,
+		       stats->frames / seconds,
+		       div64_u64(stats->wait_ns, (u64)stats->frames * 1000),
+		       div_u64(stats->wait_max_ns, 1000));
+		memset(stats, 0, sizeof(*stats));
+	}
+}
+#else
+#define B43_TX_STAMP_HEADROOM	0
+
+static inline void b43_tx_stamp(struct sk_buff *skb)
+{
+}
+
+static inline ktime_t b43_tx_get_stamp(struct sk_buff *skb)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void b43_tx_account_wait(struct b43_wl *wl, int queue_num,
+				       ktime_t stamp)
+{
+}
+#endif /* B43_DEBUG */
+
 static void b43_periodic_every15sec(struct b43_wldev *dev)
 {
 	struct b43_phy *phy = &dev->phy;
@@ -3217,6 +3998,19 @@ static void b43_periodic_every15sec(struct b43_wldev *dev)
 				dev->irq_bit_count[i] = 0;
 			}
 		}
+		if (dev->poll_count) {
+			b43dbg(dev->wl, "Stats: %7u polls/sec, "
+			       "%7u TX status/poll, %7u repolls/sec\n",
+			       dev->poll_count / 15,
+			       dev->poll_txstatus_count / dev->poll_count,
+			       dev->repoll_count / 15);
+		}
+		dev->poll_count = 0;
+		dev->poll_txstatus_count = 0;
+		dev->repoll_count = 0;
+		mutex_lock(&dev->wl->tx_mutex);
+		b43_tx_print_stats(dev, 15);
+		mutex_unlock(&dev->wl->tx_mutex);
 	}
 #endif
 }
@@ -3393,47 +4187,227 @@ static int b43_rng_init(struct b43_wl *wl)
 	return err;
 }
 
-static void b43_tx_work(struct work_struct *work)
+/* Move up to "max" frames from the head of "queue" to "batch", taking
+ * the queue lock only once. This only saves queue lock round trips: the
+ * frames are still handed to the PIO or DMA layer one by one, which
+ * writes the DMA doorbell for every frame. */
+static unsigned int b43_tx_dequeue_batch(struct sk_buff_head *queue,
+					 struct sk_buff_head *batch,
+					 unsigned int max)
 {
-	struct b43_wl *wl = container_of(work, struct b43_wl, tx_work);
-	struct b43_wldev *dev;
 	struct sk_buff *skb;
-	int queue_num;
-	int err = 0;
+	unsigned long flags;
+	unsigned int count;
 
-	mutex_lock(&wl->mutex);
-	dev = wl->current_dev;
-	if (unlikely(!dev || b43_status(dev) < B43_STAT_STARTED)) {
-		mutex_unlock(&wl->mutex);
-		return;
+	spin_lock_irqsave(&queue->lock, flags);
+	if (skb_queue_len(queue) <= max) {
+		count = skb_queue_len(queue);
+		skb_queue_splice_tail_init(queue, batch);
+	} else {
+		for (count = 0; count < max; count++) {
+			skb = __skb_dequeue(queue);
+			__skb_queue_tail(batch, skb);
+		}
 	}
+	spin_unlock_irqrestore(&queue->lock, flags);
 
-	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++) {
-		while (skb_queue_len(&wl->tx_queue[queue_num])) {
-			skb = skb_dequeue(&wl->tx_queue[queue_num]);
+	return count;
+}
+
+/* Put the frames of "batch" that were not sent back to the head of
+ * "queue", in their original order. */
+static void b43_tx_requeue_batch(struct sk_buff_head *queue,
+				 struct sk_buff_head *batch)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->lock, flags);
+	skb_queue_splice_init(batch, queue);
+	spin_unlock_irqrestore(&queue->lock, flags);
+}
+
+/* Deficit round robin weights of the queues, in units of
+ * B43_TX_DRR_QUANTUM bytes per round. Indexed by mac80211 queue number. */
+static const u8 b43_tx_drr_weights[B43_QOS_QUEUE_NUM] = {
+	[0] = 4,	/* Voice */
+	[1] = 3,	/* Video */
+	[2] = 2,	/* Best effort */
+	[3] = 1,	/* Background */
+};
+
+/* Hand the frames of one queue to the PIO or DMA layer, until the queue
+ * is empty or the ring is full. With a "deficit" it also stops before
+ * the first frame that is larger than the deficit, and deducts the
+ * length of the frames that were sent from it.
+ * Returns -ENOSPC if the ring is full, 0 otherwise. */
+static int b43_tx_queue_run(struct b43_wldev *dev, int queue_num,
+			    int *deficit)
+{
+	struct b43_wl *wl = dev->wl;
+	struct sk_buff_head *queue = &wl->tx_queue[queue_num];
+	struct sk_buff_head batch;
+	struct sk_buff *skb;
+	bool after_dtim;
+	ktime_t stamp;
+	unsigned int max_batch;
+	unsigned int len;
+	int err;
+
+	max_batch = max(modparam_txbatch, 1);
+	__skb_queue_head_init(&batch);
+	while (b43_tx_dequeue_batch(queue, &batch, max_batch)) {
+		while ((skb = __skb_dequeue(&batch))) {
+			len = skb->len;
+			if (deficit && (int)len > *deficit) {
+				__skb_queue_head(&batch, skb);
+				b43_tx_requeue_batch(queue, &batch);
+				return 0;
+			}
+			if (b43_tx_bql_full(dev, queue_num)) {
+				__skb_queue_head(&batch, skb);
+				b43_tx_requeue_batch(queue, &batch);
+				set_bit(queue_num, &wl->tx_bql_stopped);
+				ieee80211_stop_queue(wl->hw, queue_num);
+				return 0;
+			}
+			after_dtim = !!(IEEE80211_SKB_CB(skb)->flags &
+					IEEE80211_TX_CTL_SEND_AFTER_DTIM);
+			stamp = b43_tx_get_stamp(skb);
 			if (b43_using_pio_transfers(dev))
 				err = b43_pio_tx(dev, skb);
 			else
 				err = b43_dma_tx(dev, skb);
 			if (err == -ENOSPC) {
-				wl->tx_queue_stopped[queue_num] = 1;
-				ieee80211_stop_queue(wl->hw, queue_num);
-				skb_queue_head(&wl->tx_queue[queue_num], skb);
-				break;
+				__skb_queue_head(&batch, skb);
+				b43_tx_requeue_batch(queue, &batch);
+				return err;
 			}
-			if (unlikely(err))
+			if (unlikely(err)) {
 				ieee80211_free_txskb(wl->hw, skb);
-			err = 0;
+			} else {
+				b43_tx_account_wait(wl, queue_num, stamp);
+				b43_tx_bql_queued(dev, queue_num, after_dtim);
+			}
+			if (deficit)
+				*deficit -= len;
+		}
+	}
+
+	return 0;
+}
+
+/* Strict priority: a queue is drained before the next (lower priority)
+ * queue is looked at. Returns the mask of queues whose ring is full. */
+static unsigned long b43_tx_schedule_strict(struct b43_wldev *dev)
+{
+	unsigned long full = 0;
+	int queue_num;
+
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++) {
+		if (b43_tx_queue_run(dev, queue_num, NULL))
+			full |= BIT(queue_num);
+	}
+
+	return full;
+}
+
+/* Deficit round robin: every round, each backlogged queue may send as
+ * many bytes as its weight allows, plus what it saved from earlier
+ * rounds. Returns the mask of queues whose ring is full. */
+static unsigned long b43_tx_schedule_drr(struct b43_wldev *dev)
+{
+	struct b43_wl *wl = dev->wl;
+	struct sk_buff_head *queue;
+	unsigned long full = 0;
+	int queue_num;
+	bool active;
+	int *deficit;
+
+	do {
+		active = false;
+		for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM;
+		     queue_num++) {
+			queue = &wl->tx_queue[queue_num];
+			deficit = &wl->tx_deficit[queue_num];
+			if ((full | wl->tx_bql_stopped) & BIT(queue_num))
+				continue;
+			if (!skb_queue_len(queue)) {
+				*deficit = 0;
+				continue;
+			}
+			*deficit += B43_TX_DRR_QUANTUM *
+				    b43_tx_drr_weights[queue_num];
+			if (b43_tx_queue_run(dev, queue_num, deficit))
+				full |= BIT(queue_num);
+			else if (skb_queue_len(queue))
+				active = true;
 		}
+	} while (active);
+
+	return full;
+}
+
+/* Wait until b43_tx_work() no longer hands frames to the device. The
+ * caller has taken the device out of B43_STAT_STARTED before. */
+static void b43_tx_sync(struct b43_wl *wl)
+{
+	mutex_lock(&wl->tx_mutex);
+	mutex_unlock(&wl->tx_mutex);
+}
+
+/* Change wl->current_dev. The caller holds wl->mutex; the pointer is
+ * also changed under wl->tx_mutex, which is all that b43_tx_work()
+ * holds while it uses the device. */
+static void b43_set_current_dev(struct b43_wl *wl, struct b43_wldev *dev)
+{
+	mutex_lock(&wl->tx_mutex);
+	wl->current_dev = dev;
+	mutex_unlock(&wl->tx_mutex);
+}
+
+/* Locking: wl->tx_mutex only.
+ * The TX path does not take wl->mutex, so it does not wait for
+ * configuration changes or the periodic work. Everything it uses that
+ * can change while the device is started is changed under wl->tx_mutex
+ * as well:
+ * - the TX rings, by the TX status handling;
+ * - wl->current_dev, by b43_set_current_dev();
+ * - the key table (dev->key[]) read by the TX header code, by
+ *   b43_op_set_key().
+ * The PHY and band state the TX header code reads only changes together
+ * with the device: the old one is stopped (and b43_tx_sync() waits for
+ * a TX run that saw it started) before the new one is published. */
+static void b43_tx_work(struct work_struct *work)
+{
+	struct b43_wl *wl = container_of(work, struct b43_wl, tx_work);
+	struct b43_wldev *dev;
+	unsigned long full;
+	int queue_num;
+
+	mutex_lock(&wl->tx_mutex);
+	dev = wl->current_dev;
+	if (unlikely(!dev || b43_status(dev) < B43_STAT_STARTED)) {
+		mutex_unlock(&wl->tx_mutex);
+		return;
+	}
+
+	if (modparam_txsched == B43_TXSCHED_DRR)
+		full = b43_tx_schedule_drr(dev);
+	else
+		full = b43_tx_schedule_strict(dev);
 
-		if (!err)
+	for (queue_num = 0; queue_num < B43_QOS_QUEUE_NUM; queue_num++) {
+		if (full & BIT(queue_num)) {
+			wl->tx_queue_stopped[queue_num] = 1;
+			ieee80211_stop_queue(wl->hw, queue_num);
+		} else
 			wl->tx_queue_stopped[queue_num] = 0;
 	}
 
 #if B43_DEBUG
 	dev->tx_count++;
 #endif
-	mutex_unlock(&wl->mutex);
+	mutex_unlock(&wl->tx_mutex);
 }
 
 static void b43_op_tx(struct ieee80211_hw *hw,
@@ -3449,6 +4423,7 @@ static void b43_op_tx(struct ieee80211_hw *hw,
 	}
 	B43_WARN_ON(skb_shinfo(skb)->nr_frags);
 
+	b43_tx_stamp(skb);
 	skb_queue_tail(&wl->tx_queue[skb->queue_mapping], skb);
 	if (!wl->tx_queue_stopped[skb->queue_mapping]) {
 		ieee80211_queue_work(wl->hw, &wl->tx_work);
@@ -3805,12 +4780,12 @@ static int b43_switch_band(struct b43_wl *wl, struct ieee80211_channel *chan)
 	}
 	B43_WARN_ON(b43_status(up_dev) != prev_status);
 
-	wl->current_dev = up_dev;
+	b43_set_current_dev(wl, up_dev);
 
 	return 0;
 init_failure:
 	/* Whoops, failed to init the new core. No core is operating now. */
-	wl->current_dev = NULL;
+	b43_set_current_dev(wl, NULL);
 	return err;
 }
 
@@ -4090,6 +5065,8 @@ static int b43_op_set_key(struct ieee80211_hw *hw, enum set_key_cmd cmd,
 	if (index > 3)
 		goto out_unlock;
 
+	/* The TX header code reads dev->key[] under wl->tx_mutex only. */
+	mutex_lock(&wl->tx_mutex);
 	switch (cmd) {
 	case SET_KEY:
 		if (algorithm == B43_SEC_ALGO_TKIP &&
@@ -4097,13 +5074,13 @@ static int b43_op_set_key(struct ieee80211_hw *hw, enum set_key_cmd cmd,
 		    !modparam_hwtkip)) {
 			/* We support only pairwise key */
 			err = -EOPNOTSUPP;
-			goto out_unlock;
+			goto out_unlock_tx;
 		}
 
 		if (key->flags & IEEE80211_KEY_FLAG_PAIRWISE) {
 			if (WARN_ON(!sta)) {
 				err = -EOPNOTSUPP;
-				goto out_unlock;
+				goto out_unlock_tx;
 			}
 			/* Pairwise key with an assigned MAC address. */
 			err = b43_key_write(dev, -1, algorithm,
@@ -4115,7 +5092,7 @@ static int b43_op_set_key(struct ieee80211_hw *hw, enum set_key_cmd cmd,
 					    key->key, key->keylen, NULL, key);
 		}
 		if (err)
-			goto out_unlock;
+			goto out_unlock_tx;
 
 		if (algorithm == B43_SEC_ALGO_WEP40 ||
 		    algorithm == B43_SEC_ALGO_WEP104) {
@@ -4131,13 +5108,15 @@ static int b43_op_set_key(struct ieee80211_hw *hw, enum set_key_cmd cmd,
 	case DISABLE_KEY: {
 		err = b43_key_clear(dev, key->hw_key_idx);
 		if (err)
-			goto out_unlock;
+			goto out_unlock_tx;
 		break;
 	}
 	default:
 		B43_WARN_ON(1);
 	}
 
+out_unlock_tx:
+	mutex_unlock(&wl->tx_mutex);
 out_unlock:
 	if (!err) {
 		b43dbg(wl, "%s hardware based encryption for keyidx: %d, "
@@ -4220,6 +5199,7 @@ redo:
 
 	/* Disable interrupts on the device. */
 	b43_set_status(dev, B43_STAT_INITIALIZED);
+	b43_tx_sync(wl);
 	if (b43_bus_host_is_sdio(dev->dev)) {
 		/* wl->mutex is locked. That is enough. */
 		b43_write32(dev, B43_MMIO_GEN_IRQ_MASK, 0);
@@ -4233,6 +5213,10 @@ redo:
 	/* Synchronize and free the interrupt handlers. Unlock to avoid deadlocks. */
 	orig_dev = dev;
 	mutex_unlock(&wl->mutex);
+	/* The device is not started anymore, so neither the interrupt
+	 * thread nor the poll itself queues a poll. Wait for a queued or
+	 * running poll before the interrupt handlers go away. */
+	cancel_work_sync(&dev->irq_poll_work);
 	if (b43_bus_host_is_sdio(dev->dev)) {
 		b43_sdio_free_irq(dev);
 	} else {
@@ -4294,6 +5278,7 @@ static int b43_wireless_core_start(struct b43_wldev *dev)
 	}
 
 	/* We are ready to run. */
+	b43_tx_bql_reset(dev->wl);
 	ieee80211_wake_queues(dev->wl->hw);
 	b43_set_status(dev, B43_STAT_STARTED);
 
@@ -4661,10 +5646,12 @@ static int b43_wireless_core_init(struct b43_wldev *dev)
 {
 	struct ssb_sprom *sprom = dev->dev->bus_sprom;
 	struct b43_phy *phy = &dev->phy;
+	struct b43_bringup_phase phase, core_phase;
 	int err;
 	u64 hf;
 
 	B43_WARN_ON(b43_status(dev) != B43_STAT_UNINIT);
+	b43_bringup_phase_begin(dev, &core_phase, "Core init");
 
 	err = b43_bus_powerup(dev, 0);
 	if (err)
@@ -4767,17 +5754,22 @@ static int b43_wireless_core_init(struct b43_wldev *dev)
 	}
 	if (err)
 		goto err_chip_exit;
+	b43_bringup_phase_begin(dev, &phase, "QoS init");
 	b43_qos_init(dev);
+	b43_bringup_phase_end(dev, &phase);
 	b43_set_synth_pu_delay(dev, 1);
 	b43_bluetooth_coext_enable(dev);
 
 	b43_bus_powerup(dev, !(sprom->boardflags_lo & B43_BFL_XTAL_NOSLOW));
 	b43_upload_card_macaddress(dev);
+	b43_bringup_phase_begin(dev, &phase, "Security init");
 	b43_security_init(dev);
+	b43_bringup_phase_end(dev, &phase);
 
 	ieee80211_wake_queues(dev->wl->hw);
 
 	b43_set_status(dev, B43_STAT_INITIALIZED);
+	b43_bringup_phase_end(dev, &core_phase);
 
 	/* Register HW RNG driver */
 	b43_rng_init(dev->wl);
@@ -5069,7 +6061,7 @@ static void b43_chip_reset(struct work_struct *work)
 	}
 out:
 	if (err)
-		wl->current_dev = NULL; /* Failed to init the dev. */
+		b43_set_current_dev(wl, NULL); /* Failed to init the dev. */
 	mutex_unlock(&wl->mutex);
 
 	if (err) {
@@ -5118,6 +6110,7 @@ static int b43_wireless_core_attach(struct b43_wldev *dev)
 {
 	struct b43_wl *wl = dev->wl;
 	struct pci_dev *pdev = NULL;
+	struct b43_bringup_phase phase;
 	int err;
 	u32 tmp;
 	bool have_2ghz_phy = false, have_5ghz_phy = false;
@@ -5216,17 +6209,20 @@ static int b43_wireless_core_attach(struct b43_wldev *dev)
 	dev->phy.gmode = have_2ghz_phy;
 	b43_wireless_core_reset(dev, dev->phy.gmode);
 
+	b43_bringup_phase_begin(dev, &phase, "Chip access validation");
 	err = b43_validate_chipaccess(dev);
 	if (err)
 		goto err_phy_free;
+	b43_bringup_phase_end(dev, &phase);
 	err = b43_setup_bands(dev, have_2ghz_phy, have_5ghz_phy);
 	if (err)
 		goto err_phy_free;
 
 	/* Now set some default "current_dev" */
 	if (!wl->current_dev)
-		wl->current_dev = dev;
+		b43_set_current_dev(wl, dev);
 	INIT_WORK(&dev->restart_work, b43_chip_reset);
+	INIT_WORK(&dev->irq_poll_work, b43_irq_poll_work);
 
 	dev->phy.ops->switch_analog(dev, 0);
 	b43_device_disable(dev, 0);
@@ -5275,6 +6271,7 @@ static int b43_one_core_attach(struct b43_bus_dev *dev, struct b43_wl *wl)
 	b43_set_status(wldev, B43_STAT_UNINIT);
 	wldev->bad_frames_preempt = modparam_bad_frames_preempt;
 	INIT_LIST_HEAD(&wldev->list);
+	INIT_LIST_HEAD(&wldev->fw.cache);
 
 	err = b43_wireless_core_attach(wldev);
 	if (err)
@@ -5361,6 +6358,7 @@ static struct b43_wl *b43_wireless_init(struct b43_bus_dev *dev)
 
 	wl->hw_registred = false;
 	hw->max_rates = 2;
+	hw->extra_tx_headroom = B43_TX_STAMP_HEADROOM;
 	SET_IEEE80211_DEV(hw, dev->dev);
 	if (is_valid_ether_addr(sprom->et1mac))
 		SET_IEEE80211_PERM_ADDR(hw, sprom->et1mac);
@@ -5370,6 +6368,7 @@ static struct b43_wl *b43_wireless_init(struct b43_bus_dev *dev)
 	/* Initialize struct b43_wl */
 	wl->hw = hw;
 	mutex_init(&wl->mutex);
+	mutex_init(&wl->tx_mutex);
 	spin_lock_init(&wl->hardirq_lock);
 	INIT_LIST_HEAD(&wl->devlist);
 	INIT_WORK(&wl->beacon_update_trigger, b43_beacon_update_trigger_work);
@@ -5381,6 +6380,7 @@ static struct b43_wl *b43_wireless_init(struct b43_bus_dev *dev)
 		skb_queue_head_init(&wl->tx_queue[queue_num]);
 		wl->tx_queue_stopped[queue_num] = 0;
 	}
+	b43_tx_bql_init(wl);
 
 	snprintf(chip_name, ARRAY_SIZE(chip_name),
 		 (dev->chip_id > 0x9999) ? "%d" : "%04X", dev->chip_id);
@@ -5627,3 +6627,7 @@ static void __exit b43_exit(void)
 
 module_init(b43_init)
 module_exit(b43_exit)
+
+#if IS_ENABLED(CONFIG_B43_KUNIT_TEST)
+#include "main_test.c"
+#endif
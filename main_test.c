@@ -0,0 +1,1171 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for main.c.
+ *
+ * This file is included at the end of main.c when CONFIG_B43_KUNIT_TEST
+ * is enabled, so that it can reach the static functions.
+ *
+ * b43-initvals: the program compiled from an initvals file is replayed
+ * against a simulated register file and compared with the plain decoding
+ * of the file: the 16-bit writes must be the same, in the same order, and
+ * a 32-bit write may only replace two 16-bit writes to a register that
+ * takes 32-bit writes.
+ *
+ * b43-bringup: the bring-up paths run against a simulated register
+ * backend (see struct b43_sim), which checks what they leave in the
+ * registers and in SHM and reports their MMIO transactions and bus time.
+ *
+ * b43-firmware: the firmware files are requested from a stand-in loader
+ * that answers after a fixed latency, all at once and one by one.
+ *
+ * b43-tx: frames are taken off a TX queue in batches and put back.
+ */
+
+#include <kunit/test.h>
+#include <linux/vmalloc.h>
+
+#define B43_IV_TEST_REGS	0x1000
+
+struct b43_iv_test_write {
+	u16 offset;
+	u16 value;
+};
+
+/* A simulated register file that logs every write as 16-bit halves. */
+struct b43_iv_test_regs {
+	u16 regs[B43_IV_TEST_REGS / 2];
+	struct b43_iv_test_write log[256];
+	unsigned int count;
+};
+
+static void b43_iv_test_write16(struct kunit *test,
+				struct b43_iv_test_regs *r,
+				u16 offset, u16 value)
+{
+	KUNIT_ASSERT_LT(test, offset, B43_IV_TEST_REGS);
+	KUNIT_ASSERT_LT(test, r->count, ARRAY_SIZE(r->log));
+	r->regs[offset / 2] = value;
+	r->log[r->count].offset = offset;
+	r->log[r->count].value = value;
+	r->count++;
+}
+
+/* The registers that take 32-bit writes, independently of main.c. */
+static bool b43_iv_test_reg32(u16 offset)
+{
+	return offset == B43_MMIO_TSF_CFP_REP ||
+	       offset == B43_MMIO_TSF_CFP_START;
+}
+
+/* An initvals file under construction. */
+struct b43_iv_test_file {
+	u8 data[1024];
+	size_t size;
+	u32 count;
+};
+
+static void b43_iv_test_init(struct b43_iv_test_file *f)
+{
+	memset(f, 0, sizeof(*f));
+	f->size = sizeof(struct b43_fw_header);
+}
+
+static void b43_iv_test_add16(struct b43_iv_test_file *f,
+			      u16 offset, u16 value)
+{
+	put_unaligned_be16(offset, f->data + f->size);
+	put_unaligned_be16(value, f->data + f->size + 2);
+	f->size += 4;
+	f->count++;
+}
+
+static void b43_iv_test_add32(struct b43_iv_test_file *f,
+			      u16 offset, u32 value)
+{
+	put_unaligned_be16(offset | B43_IV_32BIT, f->data + f->size);
+	put_unaligned_be32(value, f->data + f->size + 2);
+	f->size += 6;
+	f->count++;
+}
+
+static void b43_iv_test_blob(struct b43_iv_test_file *f,
+			     struct firmware *blob)
+{
+	struct b43_fw_header *hdr = (struct b43_fw_header *)f->data;
+
+	hdr->type = B43_FW_TYPE_IV;
+	hdr->ver = 1;
+	hdr->size = cpu_to_be32(f->count);
+	blob->size = f->size;
+	blob->data = f->data;
+}
+
+/* Decode the file record by record, without the compiler. */
+static void b43_iv_test_reference(struct kunit *test,
+				  const struct b43_iv_test_file *f,
+				  struct b43_iv_test_regs *r)
+{
+	size_t pos = sizeof(struct b43_fw_header);
+	u16 offset;
+	u32 value;
+
+	while (pos < f->size) {
+		offset = get_unaligned_be16(f->data + pos);
+		if (offset & B43_IV_32BIT) {
+			offset &= B43_IV_OFFSET_MASK;
+			value = get_unaligned_be32(f->data + pos + 2);
+			b43_iv_test_write16(test, r, offset, value);
+			b43_iv_test_write16(test, r, offset + 2, value >> 16);
+			pos += 6;
+		} else {
+			value = get_unaligned_be16(f->data + pos + 2);
+			b43_iv_test_write16(test, r, offset, value);
+			pos += 4;
+		}
+	}
+}
+
+/* Replay the compiled program and check the width of every write. */
+static void b43_iv_test_replay(struct kunit *test,
+			       const struct b43_iv_test_file *f,
+			       const struct b43_iv_prog *prog,
+			       struct b43_iv_test_regs *r)
+{
+	const struct b43_iv_op *op;
+	size_t pos = sizeof(struct b43_fw_header);
+	size_t i;
+	bool rec32;
+
+	for (i = 0; i < prog->count; i++) {
+		op = &prog->ops[i];
+		KUNIT_ASSERT_LT(test, pos, f->size);
+		rec32 = !!(get_unaligned_be16(f->data + pos) & B43_IV_32BIT);
+		if (op->bit32) {
+			b43_iv_test_write16(test, r, op->offset, op->value);
+			b43_iv_test_write16(test, r, op->offset + 2,
+					    op->value >> 16);
+			if (!rec32) {
+				/* Two 16-bit records were merged. */
+				KUNIT_EXPECT_TRUE_MSG(test,
+					b43_iv_test_reg32(op->offset),
+					"16-bit writes merged at 0x%03X",
+					op->offset);
+				pos += 8;
+			} else {
+				pos += 6;
+			}
+		} else {
+			KUNIT_EXPECT_FALSE(test, rec32);
+			b43_iv_test_write16(test, r, op->offset, op->value);
+			pos += 4;
+		}
+	}
+	KUNIT_EXPECT_EQ(test, pos, f->size);
+}
+
+static void b43_iv_test_check(struct kunit *test,
+			      struct b43_iv_test_file *f)
+{
+	struct b43_iv_test_regs *expected, *actual;
+	struct b43_iv_prog *prog;
+	struct firmware blob;
+	unsigned int i;
+
+	expected = kunit_kzalloc(test, sizeof(*expected), GFP_KERNEL);
+	actual = kunit_kzalloc(test, sizeof(*actual), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, expected);
+	KUNIT_ASSERT_NOT_NULL(test, actual);
+
+	b43_iv_test_blob(f, &blob);
+	prog = b43_compile_initvals(&blob);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(prog));
+
+	b43_iv_test_reference(test, f, expected);
+	b43_iv_test_replay(test, f, prog, actual);
+	kfree(prog);
+
+	KUNIT_ASSERT_EQ(test, actual->count, expected->count);
+	for (i = 0; i < expected->count; i++) {
+		KUNIT_EXPECT_EQ(test, actual->log[i].offset,
+				expected->log[i].offset);
+		KUNIT_EXPECT_EQ(test, actual->log[i].value,
+				expected->log[i].value);
+	}
+	KUNIT_EXPECT_EQ(test, memcmp(actual->regs, expected->regs,
+				     sizeof(expected->regs)), 0);
+}
+
+/* Only the whitelisted registers get merged writes. */
+static void b43_iv_test_merge(struct kunit *test)
+{
+	struct b43_iv_test_file f;
+	struct firmware blob;
+	struct b43_iv_prog *prog;
+
+	b43_iv_test_init(&f);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP, 0x1234);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP + 2, 0x5678);
+	b43_iv_test_add16(&f, B43_MMIO_PHY_CONTROL, 0x0010);
+	b43_iv_test_add16(&f, B43_MMIO_PHY_DATA, 0xABCD);
+	b43_iv_test_add16(&f, B43_MMIO_SHM_CONTROL, 0x0001);
+	b43_iv_test_add16(&f, B43_MMIO_SHM_CONTROL + 2, 0x0002);
+	b43_iv_test_add16(&f, B43_MMIO_RADIO_CONTROL, 0x0042);
+	b43_iv_test_add16(&f, B43_MMIO_RADIO_DATA_LOW, 0x0099);
+	b43_iv_test_blob(&f, &blob);
+
+	prog = b43_compile_initvals(&blob);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(prog));
+	KUNIT_EXPECT_EQ(test, prog->count, (size_t)7);
+	KUNIT_EXPECT_TRUE(test, prog->ops[0].bit32);
+	KUNIT_EXPECT_EQ(test, prog->ops[0].value, (u32)0x56781234);
+	kfree(prog);
+
+	b43_iv_test_check(test, &f);
+}
+
+/* A 32-bit record, unaligned and out of order halves. */
+static void b43_iv_test_mixed(struct kunit *test)
+{
+	struct b43_iv_test_file f;
+
+	b43_iv_test_init(&f);
+	b43_iv_test_add32(&f, B43_MMIO_TSF_CFP_START, 0xCAFEBABE);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP + 2, 0x1111);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP, 0x2222);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_START, 0x3333);
+	b43_iv_test_add32(&f, 0x0400, 0x44445555);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_START + 2, 0x6666);
+	b43_iv_test_check(test, &f);
+}
+
+/* Random files over the whole register range. */
+static void b43_iv_test_random(struct kunit *test)
+{
+	static const u16 hot[] = {
+		B43_MMIO_TSF_CFP_REP, B43_MMIO_TSF_CFP_START,
+		B43_MMIO_PHY_CONTROL, B43_MMIO_SHM_CONTROL,
+		B43_MMIO_RADIO_CONTROL,
+	};
+	struct b43_iv_test_file f;
+	u32 seed = 1;
+	unsigned int round, i;
+	u16 offset;
+
+	for (round = 0; round < 200; round++) {
+		b43_iv_test_init(&f);
+		for (i = 0; i < 100; i++) {
+			seed = seed * 1103515245 + 12345;
+			if (seed & 0x10000)
+				offset = hot[(seed >> 20) % ARRAY_SIZE(hot)] +
+					 ((seed >> 8) & 2);
+			else
+				offset = (seed >> 8) & 0xFFC;
+			if ((seed >> 24) % 5 == 0)
+				b43_iv_test_add32(&f, offset, seed);
+			else
+				b43_iv_test_add16(&f, offset, seed >> 12);
+		}
+		b43_iv_test_check(test, &f);
+	}
+}
+
+/* Damaged files are refused. */
+static void b43_iv_test_format(struct kunit *test)
+{
+	struct b43_iv_test_file f;
+	struct firmware blob;
+
+	b43_iv_test_init(&f);
+	b43_iv_test_add32(&f, 0x0400, 0x12345678);
+	b43_iv_test_blob(&f, &blob);
+	blob.size -= 2;
+	KUNIT_EXPECT_EQ(test, PTR_ERR(b43_compile_initvals(&blob)),
+			(long)-EPROTO);
+
+	b43_iv_test_init(&f);
+	b43_iv_test_add16(&f, 0x1000, 0x0001);
+	b43_iv_test_blob(&f, &blob);
+	KUNIT_EXPECT_EQ(test, PTR_ERR(b43_compile_initvals(&blob)),
+			(long)-EPROTO);
+}
+
+static struct kunit_case b43_iv_test_cases[] = {
+	KUNIT_CASE(b43_iv_test_merge),
+	KUNIT_CASE(b43_iv_test_mixed),
+	KUNIT_CASE(b43_iv_test_random),
+	KUNIT_CASE(b43_iv_test_format),
+	{}
+};
+
+static struct kunit_suite b43_iv_test_suite = {
+	.name = "b43-initvals",
+	.test_cases = b43_iv_test_cases,
+};
+
+/* Simulated register backend.
+ *
+ * A b43_bus_dev whose register accessors work on memory: a flat register
+ * file and the SHM routings behind the B43_MMIO_SHM_CONTROL and
+ * B43_MMIO_SHM_DATA window. Every access is counted, so the bus time of
+ * a path can be estimated from a per-access cost (see b43_sim_buses[]).
+ *
+ * SHM model: each routing is an array of 32-bit words, addressed by the
+ * word offset of the control word. A 16-bit access to B43_MMIO_SHM_DATA
+ * reaches the low half of the word, one to B43_MMIO_SHM_DATA_UNALIGNED
+ * the high half. With B43_SHM_AUTOINC_W (B43_SHM_AUTOINC_R) set, the
+ * address advances after a 32-bit write (read) and after a 16-bit write
+ * (read) of the high half only: that much is what the driver may rely on.
+ */
+#define B43_SIM_REGS		0x1000
+#define B43_SIM_SHM_WORDS	2048
+#define B43_SIM_NR_ROUTINGS	(B43_SHM_RCMTA + 1)
+
+struct b43_sim {
+	struct b43_bus_dev bus;
+	struct b43_wldev dev;
+	struct b43_wl wl;
+	u8 regs[B43_SIM_REGS];
+	u32 shm[B43_SIM_NR_ROUTINGS][B43_SIM_SHM_WORDS];
+	u32 shm_control;
+	/* An access outside of the simulated registers or SHM. */
+	bool fault;
+	unsigned int reads;
+	unsigned int writes;
+};
+
+/* Per-access cost of the buses, in nanoseconds. */
+static const struct b43_sim_bus {
+	const char *name;
+	unsigned int read_ns;
+	unsigned int write_ns;
+} b43_sim_buses[] = {
+	/* PCI(e) and SoC backplane: writes are posted. */
+	{ "PCI", 1000, 150 },
+	{ "PCMCIA", 1500, 1500 },
+	/* One CMD52/CMD53 round trip per access. */
+	{ "SDIO", 25000, 25000 },
+};
+
+static struct b43_sim *b43_sim_of(struct b43_bus_dev *bus)
+{
+	return container_of(bus, struct b43_sim, bus);
+}
+
+static u32 *b43_sim_shm_word(struct b43_sim *sim)
+{
+	u16 routing = (sim->shm_control >> 16) & ~B43_SHM_AUTOINC_RW;
+	u16 offset = sim->shm_control & 0xFFFF;
+
+	if (routing >= B43_SIM_NR_ROUTINGS || offset >= B43_SIM_SHM_WORDS) {
+		sim->fault = true;
+		return NULL;
+	}
+	return &sim->shm[routing][offset];
+}
+
+static void b43_sim_shm_advance(struct b43_sim *sim, u16 autoinc)
+{
+	if ((sim->shm_control >> 16) & autoinc) {
+		sim->shm_control = (sim->shm_control & 0xFFFF0000) |
+				   ((sim->shm_control + 1) & 0xFFFF);
+	}
+}
+
+static u8 *b43_sim_reg(struct b43_sim *sim, u16 offset, unsigned int width)
+{
+	if (offset % width || offset + width > B43_SIM_REGS) {
+		sim->fault = true;
+		return NULL;
+	}
+	return &sim->regs[offset];
+}
+
+static u16 b43_sim_read16(struct b43_bus_dev *bus, u16 offset)
+{
+	struct b43_sim *sim = b43_sim_of(bus);
+	u32 *word;
+	u8 *reg;
+
+	sim->reads++;
+	if (offset == B43_MMIO_SHM_DATA) {
+		word = b43_sim_shm_word(sim);
+		return word ? *word & 0xFFFF : 0xFFFF;
+	}
+	if (offset == B43_MMIO_SHM_DATA_UNALIGNED) {
+		word = b43_sim_shm_word(sim);
+		b43_sim_shm_advance(sim, B43_SHM_AUTOINC_R);
+		return word ? *word >> 16 : 0xFFFF;
+	}
+	reg = b43_sim_reg(sim, offset, 2);
+	return reg ? get_unaligned_le16(reg) : 0xFFFF;
+}
+
+static u32 b43_sim_read32(struct b43_bus_dev *bus, u16 offset)
+{
+	struct b43_sim *sim = b43_sim_of(bus);
+	u32 *word;
+	u8 *reg;
+
+	sim->reads++;
+	if (offset == B43_MMIO_SHM_CONTROL)
+		return sim->shm_control;
+	if (offset == B43_MMIO_SHM_DATA) {
+		word = b43_sim_shm_word(sim);
+		b43_sim_shm_advance(sim, B43_SHM_AUTOINC_R);
+		return word ? *word : 0xFFFFFFFF;
+	}
+	reg = b43_sim_reg(sim, offset, 4);
+	return reg ? get_unaligned_le32(reg) : 0xFFFFFFFF;
+}
+
+static void b43_sim_write16(struct b43_bus_dev *bus, u16 offset, u16 value)
+{
+	struct b43_sim *sim = b43_sim_of(bus);
+	u32 *word;
+	u8 *reg;
+
+	sim->writes++;
+	if (offset == B43_MMIO_SHM_DATA) {
+		word = b43_sim_shm_word(sim);
+		if (word)
+			*word = (*word & 0xFFFF0000) | value;
+		return;
+	}
+	if (offset == B43_MMIO_SHM_DATA_UNALIGNED) {
+		word = b43_sim_shm_word(sim);
+		if (word)
+			*word = (*word & 0x0000FFFF) | ((u32)value << 16);
+		b43_sim_shm_advance(sim, B43_SHM_AUTOINC_W);
+		return;
+	}
+	reg = b43_sim_reg(sim, offset, 2);
+	if (reg)
+		put_unaligned_le16(value, reg);
+}
+
+static void b43_sim_write32(struct b43_bus_dev *bus, u16 offset, u32 value)
+{
+	struct b43_sim *sim = b43_sim_of(bus);
+	u32 *word;
+	u8 *reg;
+
+	sim->writes++;
+	if (offset == B43_MMIO_SHM_CONTROL) {
+		sim->shm_control = value;
+		return;
+	}
+	if (offset == B43_MMIO_SHM_DATA) {
+		word = b43_sim_shm_word(sim);
+		if (word)
+			*word = value;
+		b43_sim_shm_advance(sim, B43_SHM_AUTOINC_W);
+		return;
+	}
+	if (offset == B43_MMIO_TSF_CFP_START) {
+		/* Shadowed by the two 16bit registers. */
+		put_unaligned_le16(value & 0xFFFF,
+				   &sim->regs[B43_MMIO_TSF_CFP_START_LOW]);
+		put_unaligned_le16(value >> 16,
+				   &sim->regs[B43_MMIO_TSF_CFP_START_HIGH]);
+	}
+	reg = b43_sim_reg(sim, offset, 4);
+	if (reg)
+		put_unaligned_le32(value, reg);
+}
+
+/* A started core on a simulated BCMA bus, with new-style key indices. */
+static struct b43_sim *b43_sim_create(struct kunit *test)
+{
+	struct b43_sim *sim;
+
+	sim = kunit_kzalloc(test, sizeof(*sim), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, sim);
+	sim->bus.bus_type = B43_BUS_BCMA;
+	sim->bus.read16 = b43_sim_read16;
+	sim->bus.read32 = b43_sim_read32;
+	sim->bus.write16 = b43_sim_write16;
+	sim->bus.write32 = b43_sim_write32;
+	sim->bus.core_rev = 5;
+	sim->dev.dev = &sim->bus;
+	sim->dev.wl = &sim->wl;
+	sim->dev.fw.rev = 410;
+	put_unaligned_le32(B43_MACCTL_IHR_ENABLED,
+			   &sim->regs[B43_MMIO_MACCTL]);
+
+	return sim;
+}
+
+static u16 b43_sim_shared16(struct b43_sim *sim, u16 offset)
+{
+	u32 word = sim->shm[B43_SHM_SHARED][offset >> 2];
+
+	return (offset & 2) ? word >> 16 : word & 0xFFFF;
+}
+
+static void b43_sim_reset_counters(struct b43_sim *sim)
+{
+	sim->reads = 0;
+	sim->writes = 0;
+}
+
+static unsigned long long b43_sim_bus_us(const struct b43_sim *sim,
+					 const struct b43_sim_bus *bus)
+{
+	u64 ns = (u64)sim->reads * bus->read_ns +
+		 (u64)sim->writes * bus->write_ns;
+
+	return div_u64(ns, 1000);
+}
+
+/* Report the transactions counted since the last reset. */
+static void b43_sim_report(struct kunit *test, struct b43_sim *sim,
+			   const char *path)
+{
+	unsigned int i;
+
+	KUNIT_EXPECT_FALSE(test, sim->fault);
+	kunit_info(test, "%s: %u MMIO reads, %u MMIO writes\n",
+		   path, sim->reads, sim->writes);
+	for (i = 0; i < ARRAY_SIZE(b43_sim_buses); i++) {
+		kunit_info(test, "%s: ~%llu us bus time on %s\n", path,
+			   b43_sim_bus_us(sim, &b43_sim_buses[i]),
+			   b43_sim_buses[i].name);
+	}
+}
+
+static void b43_sim_test_chipaccess(struct kunit *test)
+{
+	struct b43_sim *sim = b43_sim_create(test);
+
+	sim->shm[B43_SHM_SHARED][0] = 0x12345678;
+	sim->shm[B43_SHM_SHARED][1] = 0x9ABCDEF0;
+	KUNIT_EXPECT_EQ(test, b43_validate_chipaccess(&sim->dev), 0);
+	/* The words used for the test are restored. */
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SHARED][0], (u32)0x12345678);
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SHARED][1], (u32)0x9ABCDEF0);
+	b43_sim_report(test, sim, "b43_validate_chipaccess");
+}
+
+static void b43_sim_test_initvals(struct kunit *test)
+{
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_iv_test_regs *expected;
+	struct b43_iv_test_file f;
+	struct b43_iv_prog *prog;
+	struct firmware blob;
+	u32 seed = 7;
+	unsigned int i;
+
+	expected = kunit_kzalloc(test, sizeof(*expected), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, expected);
+	b43_iv_test_init(&f);
+	b43_iv_test_add32(&f, B43_MMIO_TSF_CFP_START, 0x00010002);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP, 0x0003);
+	b43_iv_test_add16(&f, B43_MMIO_TSF_CFP_REP + 2, 0x0004);
+	for (i = 0; i < 150; i++) {
+		seed = seed * 1103515245 + 12345;
+		b43_iv_test_add16(&f, 0x400 + ((seed >> 8) & 0x3FE),
+				  seed >> 16);
+	}
+	b43_iv_test_blob(&f, &blob);
+	b43_iv_test_reference(test, &f, expected);
+
+	prog = b43_compile_initvals(&blob);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(prog));
+	b43_sim_reset_counters(sim);
+	b43_write_initvals(&sim->dev, prog);
+	kfree(prog);
+	b43_sim_report(test, sim, "b43_write_initvals");
+
+	for (i = 0; i < expected->count; i++) {
+		u16 offset = expected->log[i].offset;
+
+		KUNIT_EXPECT_EQ(test, get_unaligned_le16(&sim->regs[offset]),
+				expected->regs[offset / 2]);
+	}
+}
+
+static void b43_sim_test_security(struct kunit *test)
+{
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_wldev *dev = &sim->dev;
+	const u16 ktp = 0x800;
+	unsigned int i, count;
+
+	/* Key memory full of stale keys, as after a microcode upload. */
+	for (i = 0; i < B43_SIM_SHM_WORDS; i++)
+		sim->shm[B43_SHM_SHARED][i] = 0xFFFFFFFF;
+	for (i = 0; i < B43_SIM_SHM_WORDS; i++)
+		sim->shm[B43_SHM_RCMTA][i] = 0xFFFFFFFF;
+	b43_shm_write16(dev, B43_SHM_SHARED, B43_SHM_SH_KTP, ktp / 2);
+	bitmap_fill(dev->key_dirty, ARRAY_SIZE(dev->key));
+
+	b43_sim_reset_counters(sim);
+	b43_security_init(dev);
+	b43_sim_report(test, sim, "b43_security_init");
+
+	KUNIT_EXPECT_EQ(test, dev->ktp, ktp);
+	KUNIT_EXPECT_EQ(test, get_unaligned_le16(&sim->regs[B43_MMIO_RCMTA_COUNT]),
+			(u16)B43_NR_PAIRWISE_KEYS);
+	count = B43_NR_GROUP_KEYS + B43_NR_PAIRWISE_KEYS;
+	for (i = 0; i < count * B43_SEC_KEYSIZE; i += 2)
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim, ktp + i), 0);
+	for (i = 0; i < count; i++) {
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim,
+				B43_SHM_SH_KEYIDXBLOCK + i * 2),
+				(u16)(b43_kidx_to_fw(dev, i) << 4));
+	}
+	for (i = 0; i < B43_NR_PAIRWISE_KEYS; i++) {
+		KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_RCMTA][i * 2], 0);
+		KUNIT_EXPECT_EQ(test,
+				sim->shm[B43_SHM_RCMTA][i * 2 + 1] & 0xFFFF, 0);
+	}
+
+	/* Only the KTP read and the RCMTA count remain while the key memory
+	 * is known to be empty. */
+	b43_sim_reset_counters(sim);
+	b43_security_init(dev);
+	KUNIT_EXPECT_EQ(test, sim->writes, 2);
+}
+
+static void b43_sim_test_qos(struct kunit *test)
+{
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_wldev *dev = &sim->dev;
+	struct ieee80211_tx_queue_params *p;
+	unsigned int i;
+	u16 offset;
+
+	dev->qos_enabled = true;
+	/* The MAC is already suspended, so no handshake is simulated. */
+	dev->mac_suspended = 1;
+	for (i = 0; i < ARRAY_SIZE(sim->wl.qos_params); i++) {
+		p = &sim->wl.qos_params[i].p;
+		p->txop = i;
+		p->cw_min = 15;
+		p->cw_max = 1023;
+		p->aifs = 2 + i;
+	}
+
+	b43_sim_reset_counters(sim);
+	b43_qos_upload_all(dev);
+	b43_sim_report(test, sim, "b43_qos_upload_all");
+
+	for (i = 0; i < ARRAY_SIZE(sim->wl.qos_params); i++) {
+		p = &sim->wl.qos_params[i].p;
+		offset = b43_qos_shm_offsets[i];
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim,
+				offset + B43_QOSPARAM_TXOP * 2),
+				(u16)(p->txop * 32));
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim,
+				offset + B43_QOSPARAM_AIFS * 2), p->aifs);
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim,
+				offset + B43_QOSPARAM_STATUS * 2), 0x100);
+	}
+	KUNIT_EXPECT_EQ(test, dev->mac_suspended, 1);
+}
+
+static void b43_sim_test_ucode_clear(struct kunit *test)
+{
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_wldev *dev = &sim->dev;
+	unsigned int i, writes;
+
+	/* The per-word clear, for comparison. */
+	for (i = 0; i < 64; i++)
+		b43_shm_write16(dev, B43_SHM_SCRATCH, i, 0);
+	for (i = 0; i < 4096; i += 2)
+		b43_shm_write16(dev, B43_SHM_SHARED, i, 0);
+	writes = sim->writes;
+	kunit_info(test, "per-word clear: %u MMIO writes\n", writes);
+
+	for (i = 0; i < B43_SIM_SHM_WORDS; i++) {
+		sim->shm[B43_SHM_SCRATCH][i] = 0xFFFFFFFF;
+		sim->shm[B43_SHM_SHARED][i] = 0xFFFFFFFF;
+	}
+	dev->shm_shadow.valid = ~0;
+	b43_sim_reset_counters(sim);
+	b43_ucode_clear_memory(dev);
+	b43_sim_report(test, sim, "b43_ucode_clear_memory");
+	KUNIT_EXPECT_LT(test, sim->writes, writes);
+
+	for (i = 0; i < 64; i++)
+		KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SCRATCH][i] & 0xFFFF, 0);
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SCRATCH][64], (u32)0xFFFFFFFF);
+	for (i = 0; i < 4096 / sizeof(u32); i++)
+		KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SHARED][i], 0);
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_SHARED][4096 / sizeof(u32)],
+			(u32)0xFFFFFFFF);
+	KUNIT_EXPECT_EQ(test, dev->shm_shadow.valid, 0);
+}
+
+/* The elapsed time includes the udelay() calls of the paced upload. */
+static void b43_sim_test_ucode_upload(struct kunit *test)
+{
+	const unsigned int len = B43_SIM_SHM_WORDS;
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_wldev *dev = &sim->dev;
+	__be32 *data;
+	ktime_t start;
+	unsigned int i;
+
+	data = kunit_kzalloc(test, len * sizeof(*data), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, data);
+	for (i = 0; i < len; i++)
+		data[i] = cpu_to_be32(i * 0x9E3779B9);
+
+	b43_sim_reset_counters(sim);
+	start = ktime_get();
+	b43_upload_ucode_paced(dev, data, len);
+	kunit_info(test, "b43_upload_ucode_paced: %lld us\n",
+		   (long long)ktime_us_delta(ktime_get(), start));
+	b43_sim_report(test, sim, "b43_upload_ucode_paced");
+	for (i = 0; i < len; i++) {
+		KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_UCODE][i],
+				be32_to_cpu(data[i]));
+	}
+
+	memset(sim->shm[B43_SHM_UCODE], 0, sizeof(sim->shm[B43_SHM_UCODE]));
+	b43_sim_reset_counters(sim);
+	start = ktime_get();
+	KUNIT_EXPECT_EQ(test, b43_upload_ucode_verified(dev, data, len), 0);
+	kunit_info(test, "b43_upload_ucode_verified: %lld us\n",
+		   (long long)ktime_us_delta(ktime_get(), start));
+	b43_sim_report(test, sim, "b43_upload_ucode_verified");
+	for (i = 0; i < len; i++) {
+		KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_UCODE][i],
+				be32_to_cpu(data[i]));
+	}
+}
+
+/* b43_shm_write16_burst() against one b43_shm_write16() per word, at
+ * both alignments, up to the lengths of a key (8 words) and of a TKIP
+ * phase1 entry (7 words). */
+static void b43_sim_test_write16_burst(struct kunit *test)
+{
+	struct b43_sim *burst = b43_sim_create(test);
+	struct b43_sim *ref = b43_sim_create(test);
+	unsigned int i, count;
+	u16 words[9];
+	u16 start;
+
+	for (start = 0x100; start <= 0x102; start += 2) {
+		for (count = 0; count <= ARRAY_SIZE(words); count++) {
+			for (i = 0; i < count; i++)
+				words[i] = ((start & 0xF) << 12) |
+					   (count << 4) | i;
+			b43_sim_reset_counters(ref);
+			for (i = 0; i < count; i++) {
+				b43_shm_write16(&ref->dev, B43_SHM_SHARED,
+						start + i * 2, words[i]);
+			}
+			b43_sim_reset_counters(burst);
+			b43_shm_write16_burst(&burst->dev, start, words, count);
+
+			KUNIT_EXPECT_EQ(test, memcmp(burst->shm, ref->shm,
+						     sizeof(ref->shm)), 0);
+			KUNIT_EXPECT_LE(test, burst->writes, ref->writes);
+			if (count != 7 && count != 8)
+				continue;
+			kunit_info(test, "%u words at 0x%03X: %u MMIO writes, "
+				   "%u one by one\n", count, start,
+				   burst->writes, ref->writes);
+		}
+	}
+	KUNIT_EXPECT_FALSE(test, burst->fault);
+}
+
+/* A pairwise TKIP key, as written when rekeying. */
+static void b43_sim_test_rekey(struct kunit *test)
+{
+	static const u8 key[B43_SEC_KEYSIZE] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+		0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	};
+	static const u8 mac[ETH_ALEN] = {
+		0x02, 0x11, 0x22, 0x33, 0x44, 0x55,
+	};
+	struct b43_sim *sim = b43_sim_create(test);
+	struct b43_wldev *dev = &sim->dev;
+	/* The fourth pairwise slot: its TKIP entry is not 32bit aligned. */
+	const u8 index = B43_NR_GROUP_KEYS + 3;
+	const u8 slot = index - B43_NR_GROUP_KEYS;
+	int hwtkip = modparam_hwtkip;
+	unsigned int i;
+	u16 offset;
+
+	dev->ktp = 0x800;
+	modparam_hwtkip = 1;
+	b43_sim_reset_counters(sim);
+	do_key_write(dev, index, B43_SEC_ALGO_TKIP, key, sizeof(key), mac);
+	modparam_hwtkip = hwtkip;
+	b43_sim_report(test, sim, "do_key_write");
+
+	offset = dev->ktp + index * B43_SEC_KEYSIZE;
+	for (i = 0; i < B43_SEC_KEYSIZE; i += 2) {
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim, offset + i),
+				(u16)(key[i] | (key[i + 1] << 8)));
+	}
+	KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim,
+			B43_SHM_SH_KEYIDXBLOCK + index * 2),
+			(u16)((b43_kidx_to_fw(dev, index) << 4) |
+			      B43_SEC_ALGO_TKIP));
+	offset = B43_SHM_SH_TKIPTSCTTAK + slot * (10 + 4);
+	for (i = 0; i < 10; i += 2)
+		KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim, offset + i), 0);
+	KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim, offset + 10), 0xFFFF);
+	KUNIT_EXPECT_EQ(test, b43_sim_shared16(sim, offset + 12), 0xFFFF);
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_RCMTA][slot * 2],
+			(u32)0x33221102);
+	KUNIT_EXPECT_EQ(test, sim->shm[B43_SHM_RCMTA][slot * 2 + 1] & 0xFFFF,
+			(u32)0x5544);
+}
+
+static struct kunit_case b43_sim_test_cases[] = {
+	KUNIT_CASE(b43_sim_test_chipaccess),
+	KUNIT_CASE(b43_sim_test_initvals),
+	KUNIT_CASE(b43_sim_test_security),
+	KUNIT_CASE(b43_sim_test_qos),
+	KUNIT_CASE(b43_sim_test_ucode_clear),
+	KUNIT_CASE(b43_sim_test_ucode_upload),
+	KUNIT_CASE(b43_sim_test_write16_burst),
+	KUNIT_CASE(b43_sim_test_rekey),
+	{}
+};
+
+static struct kunit_suite b43_sim_test_suite = {
+	.name = "b43-bringup",
+	.test_cases = b43_sim_test_cases,
+};
+
+/* Stand-in firmware loader.
+ *
+ * Every request completes after B43_FW_TEST_LATENCY_MS, from a delayed
+ * work as with the real loader, with a small file whose header matches
+ * its name. The file named by b43_fw_test.missing does not exist. The
+ * loader counts the requests and how many of them were in flight at the
+ * same time.
+ */
+#define B43_FW_TEST_LATENCY_MS	20
+
+static struct {
+	const char *missing;
+	atomic_t requests;
+	atomic_t in_flight;
+	int max_in_flight;
+} b43_fw_test;
+
+struct b43_fw_test_load {
+	struct delayed_work work;
+	const char *name;
+	void *context;
+	void (*cont)(const struct firmware *fw, void *context);
+};
+
+static bool b43_fw_test_missing(const char *name)
+{
+	return b43_fw_test.missing && strstr(name, b43_fw_test.missing);
+}
+
+/* The file is released by release_firmware() like one that was loaded
+ * directly: vmalloc()ed data and no private data. */
+static const struct firmware *b43_fw_test_blob(const char *name)
+{
+	struct b43_fw_header *hdr;
+	struct firmware *blob;
+	size_t payload = 64;
+	u8 *data;
+	u8 type;
+
+	if (strstr(name, "/ucode")) {
+		type = B43_FW_TYPE_UCODE;
+	} else if (strstr(name, "/pcm")) {
+		type = B43_FW_TYPE_PCM;
+	} else {
+		/* An initvals file without records. */
+		type = B43_FW_TYPE_IV;
+		payload = 0;
+	}
+	blob = kzalloc(sizeof(*blob), GFP_KERNEL);
+	data = vzalloc(sizeof(*hdr) + payload);
+	if (!blob || !data) {
+		kfree(blob);
+		vfree(data);
+		return NULL;
+	}
+	hdr = (struct b43_fw_header *)data;
+	hdr->type = type;
+	hdr->ver = 1;
+	hdr->size = cpu_to_be32(payload);
+	blob->data = data;
+	blob->size = sizeof(*hdr) + payload;
+
+	return blob;
+}
+
+static void b43_fw_test_work(struct work_struct *work)
+{
+	struct b43_fw_test_load *load =
+		container_of(work, struct b43_fw_test_load, work.work);
+	const struct firmware *blob = NULL;
+
+	if (!b43_fw_test_missing(load->name))
+		blob = b43_fw_test_blob(load->name);
+	atomic_dec(&b43_fw_test.in_flight);
+	load->cont(blob, load->context);
+	kfree(load);
+}
+
+static int b43_fw_test_request_nowait(struct module *module, bool uevent,
+				      const char *name, struct device *device,
+				      gfp_t gfp, void *context,
+				      void (*cont)(const struct firmware *fw,
+						   void *context))
+{
+	struct b43_fw_test_load *load;
+	int in_flight;
+
+	load = kzalloc(sizeof(*load), gfp);
+	if (!load)
+		return -ENOMEM;
+	load->name = name;
+	load->context = context;
+	load->cont = cont;
+	INIT_DELAYED_WORK(&load->work, b43_fw_test_work);
+	atomic_inc(&b43_fw_test.requests);
+	in_flight = atomic_inc_return(&b43_fw_test.in_flight);
+	b43_fw_test.max_in_flight = max(b43_fw_test.max_in_flight, in_flight);
+	schedule_delayed_work(&load->work,
+			      msecs_to_jiffies(B43_FW_TEST_LATENCY_MS));
+
+	return 0;
+}
+
+/* The synchronous fallback after an asynchronous request failed. */
+static int b43_fw_test_request(const struct firmware **fw, const char *name,
+			       struct device *device)
+{
+	atomic_inc(&b43_fw_test.requests);
+	msleep(B43_FW_TEST_LATENCY_MS);
+	*fw = NULL;
+	if (b43_fw_test_missing(name))
+		return -ENOENT;
+	*fw = b43_fw_test_blob(name);
+
+	return *fw ? 0 : -ENOMEM;
+}
+
+static const struct b43_fw_loader b43_fw_test_loader = {
+	.request	= b43_fw_test_request,
+	.request_nowait	= b43_fw_test_request_nowait,
+};
+
+/* A device that needs the files of a rev 5 G-PHY core. */
+struct b43_fw_test_dev {
+	struct b43_bus_dev bus;
+	struct b43_wldev dev;
+	struct b43_request_fw_context ctx;
+	struct b43_fw_request reqs[4];
+};
+
+static struct b43_fw_test_dev *b43_fw_test_create(struct kunit *test,
+						  const char *missing)
+{
+	struct b43_fw_test_dev *t;
+	struct b43_firmware *fw;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, t);
+	t->dev.dev = &t->bus;
+	INIT_LIST_HEAD(&t->dev.fw.cache);
+	t->ctx.dev = &t->dev;
+	t->ctx.req_type = B43_FWTYPE_PROPRIETARY;
+
+	fw = &t->dev.fw;
+	t->reqs[0].name = "ucode5";
+	t->reqs[0].fw = &fw->ucode;
+	t->reqs[1].name = "pcm5";
+	t->reqs[1].fw = &fw->pcm;
+	t->reqs[1].optional = true;
+	t->reqs[2].name = "b0g0initvals5";
+	t->reqs[2].fw = &fw->initvals;
+	t->reqs[3].name = "b0g0bsinitvals5";
+	t->reqs[3].fw = &fw->initvals_band;
+
+	memset(&b43_fw_test, 0, sizeof(b43_fw_test));
+	b43_fw_test.missing = missing;
+
+	return t;
+}
+
+static void b43_fw_test_reset(void)
+{
+	atomic_set(&b43_fw_test.requests, 0);
+	b43_fw_test.max_in_flight = 0;
+}
+
+static void b43_fw_test_batched(struct kunit *test)
+{
+	struct b43_fw_test_dev *t = b43_fw_test_create(test, NULL);
+	struct b43_firmware *fw = &t->dev.fw;
+	s64 batched_us, serial_us;
+	ktime_t start;
+	unsigned int i;
+	int err;
+
+	start = ktime_get();
+	err = b43_request_fw_files(&t->ctx, &b43_fw_test_loader,
+				   t->reqs, ARRAY_SIZE(t->reqs));
+	batched_us = ktime_us_delta(ktime_get(), start);
+	KUNIT_EXPECT_EQ(test, err, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&b43_fw_test.requests), 4);
+	KUNIT_EXPECT_EQ(test, b43_fw_test.max_in_flight, 4);
+	KUNIT_EXPECT_TRUE(test, fw->ucode.data && fw->pcm.data &&
+			  fw->initvals.data && fw->initvals_band.data);
+
+	/* The same files, requested one after the other. */
+	b43_release_firmware(&t->dev);
+	b43_fw_test_reset();
+	start = ktime_get();
+	for (i = 0; i < ARRAY_SIZE(t->reqs); i++) {
+		err = b43_request_fw_files(&t->ctx, &b43_fw_test_loader,
+					   &t->reqs[i], 1);
+		KUNIT_EXPECT_EQ(test, err, 0);
+	}
+	serial_us = ktime_us_delta(ktime_get(), start);
+	KUNIT_EXPECT_EQ(test, atomic_read(&b43_fw_test.requests), 4);
+	KUNIT_EXPECT_EQ(test, b43_fw_test.max_in_flight, 1);
+
+	kunit_info(test, "4 files, %u ms loader latency: %lld us batched, "
+		   "%lld us one by one\n", B43_FW_TEST_LATENCY_MS,
+		   (long long)batched_us, (long long)serial_us);
+	KUNIT_EXPECT_LT(test, batched_us, serial_us);
+
+	/* Cached files are not requested again. */
+	b43_fw_test_reset();
+	err = b43_request_fw_files(&t->ctx, &b43_fw_test_loader,
+				   t->reqs, ARRAY_SIZE(t->reqs));
+	KUNIT_EXPECT_EQ(test, err, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&b43_fw_test.requests), 0);
+
+	b43_release_firmware(&t->dev);
+}
+
+/* A missing optional file is reported but not an error. */
+static void b43_fw_test_missing_optional(struct kunit *test)
+{
+	struct b43_fw_test_dev *t = b43_fw_test_create(test, "/pcm5.fw");
+	struct b43_firmware *fw = &t->dev.fw;
+	int err;
+
+	err = b43_request_fw_files(&t->ctx, &b43_fw_test_loader,
+				   t->reqs, ARRAY_SIZE(t->reqs));
+	KUNIT_EXPECT_EQ(test, err, 0);
+	KUNIT_EXPECT_EQ(test, t->reqs[1].err, -ENOENT);
+	KUNIT_EXPECT_TRUE(test, !fw->pcm.data);
+	KUNIT_EXPECT_TRUE(test, fw->ucode.data && fw->initvals.data &&
+			  fw->initvals_band.data);
+	KUNIT_EXPECT_TRUE(test,
+		strstr(t->ctx.errors[B43_FWTYPE_PROPRIETARY],
+		       "\"b43/pcm5.fw\" not found") != NULL);
+
+	b43_release_firmware(&t->dev);
+}
+
+/* A missing file fails the request and the files after it are dropped. */
+static void b43_fw_test_missing_required(struct kunit *test)
+{
+	struct b43_fw_test_dev *t = b43_fw_test_create(test,
+						       "/b0g0initvals5.fw");
+	struct b43_firmware *fw = &t->dev.fw;
+	int err;
+
+	err = b43_request_fw_files(&t->ctx, &b43_fw_test_loader,
+				   t->reqs, ARRAY_SIZE(t->reqs));
+	KUNIT_EXPECT_EQ(test, err, -ENOENT);
+	KUNIT_EXPECT_EQ(test, t->reqs[0].err, 0);
+	KUNIT_EXPECT_EQ(test, t->reqs[1].err, 0);
+	KUNIT_EXPECT_EQ(test, t->reqs[2].err, -ENOENT);
+	KUNIT_EXPECT_TRUE(test, !fw->initvals.data && !fw->initvals_band.data);
+	KUNIT_EXPECT_TRUE(test,
+		strstr(t->ctx.errors[B43_FWTYPE_PROPRIETARY],
+		       "\"b43/b0g0initvals5.fw\" not found") != NULL);
+
+	b43_release_firmware(&t->dev);
+}
+
+static struct kunit_case b43_fw_test_cases[] = {
+	KUNIT_CASE(b43_fw_test_batched),
+	KUNIT_CASE(b43_fw_test_missing_optional),
+	KUNIT_CASE(b43_fw_test_missing_required),
+	{}
+};
+
+static struct kunit_suite b43_fw_test_suite = {
+	.name = "b43-firmware",
+	.test_cases = b43_fw_test_cases,
+};
+
+#define B43_TX_TEST_FRAMES	40
+#define B43_TX_TEST_BATCH	16
+
+/* The frames are numbered in skb->priority. */
+static void b43_tx_test_batch(struct kunit *test)
+{
+	struct sk_buff_head queue, batch;
+	unsigned int i, count, next = 0;
+	unsigned int frames, rounds = 0;
+	struct sk_buff *skb;
+
+	skb_queue_head_init(&queue);
+	__skb_queue_head_init(&batch);
+	for (i = 0; i < B43_TX_TEST_FRAMES; i++) {
+		skb = alloc_skb(0, GFP_KERNEL);
+		KUNIT_ASSERT_NOT_NULL(test, skb);
+		skb->priority = i;
+		skb_queue_tail(&queue, skb);
+	}
+
+	/* Send three frames of a batch and put the others back. */
+	count = b43_tx_dequeue_batch(&queue, &batch, B43_TX_TEST_BATCH);
+	KUNIT_EXPECT_EQ(test, count, B43_TX_TEST_BATCH);
+	for (i = 0; i < 3; i++) {
+		skb = __skb_dequeue(&batch);
+		KUNIT_EXPECT_EQ(test, skb->priority, next++);
+		kfree_skb(skb);
+	}
+	b43_tx_requeue_batch(&queue, &batch);
+	KUNIT_EXPECT_TRUE(test, skb_queue_empty(&batch));
+	frames = skb_queue_len(&queue);
+	KUNIT_EXPECT_EQ(test, frames, B43_TX_TEST_FRAMES - 3);
+
+	/* Drain the queue, in the original order. */
+	while ((count = b43_tx_dequeue_batch(&queue, &batch,
+					     B43_TX_TEST_BATCH))) {
+		rounds++;
+		KUNIT_EXPECT_LE(test, count, B43_TX_TEST_BATCH);
+		KUNIT_EXPECT_EQ(test, skb_queue_len(&batch), count);
+		while ((skb = __skb_dequeue(&batch))) {
+			KUNIT_EXPECT_EQ(test, skb->priority, next++);
+			kfree_skb(skb);
+		}
+	}
+	KUNIT_EXPECT_EQ(test, next, B43_TX_TEST_FRAMES);
+	KUNIT_EXPECT_EQ(test, rounds,
+			DIV_ROUND_UP(frames, B43_TX_TEST_BATCH));
+	kunit_info(test, "%u frames: %u queue lock round trips, %u one by one\n",
+		   frames, rounds, frames);
+}
+
+static struct kunit_case b43_tx_test_cases[] = {
+	KUNIT_CASE(b43_tx_test_batch),
+	{}
+};
+
+static struct kunit_suite b43_tx_test_suite = {
+	.name = "b43-tx",
+	.test_cases = b43_tx_test_cases,
+};
+
+kunit_test_suites(&b43_iv_test_suite, &b43_sim_test_suite,
+		  &b43_fw_test_suite, &b43_tx_test_suite);
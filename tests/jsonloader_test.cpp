@@ -0,0 +1,198 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        jsonloader_test.cpp
+// Purpose:     checks the work-stealing wxJSONFileLoader
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ A set of files is written to the temporary directory: many small valid
+ files (which are batched), some large ones (one task each), some with
+ syntax errors, plus names of files that do not exist.
+ The files are loaded with several thread counts and batch sizes and the
+ program checks that:
+
+   - the handler is called exactly once for every file
+   - the calls to the handler never overlap
+   - every valid file is reported with its own value and no error
+   - the return value of Load() is the number of invalid and missing files
+
+ The handler keeps a copy of every value it gets, as an application
+ would, so that the values are shared with the worker threads.
+
+ The program needs the wxJSON library and wxBase:
+
+   g++ -O2 -I.. jsonloader_test.cpp `wx-config --cxxflags --libs base` \
+       -lwxjson -o jsonloader_test
+   ./jsonloader_test
+
+ It returns zero if all the checks pass.
+*/
+
+#include "jsonloader.h"
+#include "jsonval.h"
+
+#include <wx/init.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/hashmap.h>
+
+#include <stdio.h>
+
+WX_DECLARE_STRING_HASH_MAP( int, wxJSONTestCountMap );
+
+static const int NUM_SMALL   = 400;
+static const int NUM_LARGE   = 8;
+static const int NUM_INVALID = 20;
+static const int NUM_MISSING = 5;
+
+static int s_failures = 0;
+
+class TestHandler : public wxJSONLoadHandler
+{
+public:
+    TestHandler()
+    {
+        m_inside   = 0;
+        m_overlaps = 0;
+        m_errors   = 0;
+    }
+
+    virtual void OnFileLoaded( const wxString& fileName, wxJSONValue& value,
+                        const wxArrayString& errors, const wxArrayString& warnings )
+    {
+        // the loader serializes the calls: this is not protected
+        if ( ++m_inside != 1 )  {
+            ++m_overlaps;
+        }
+        ++m_calls[fileName];
+        if ( errors.GetCount() > 0 )  {
+            ++m_errors;
+        }
+        // keep copies, sharing their data with the loader's
+        m_values[fileName] = value;
+        WX_APPEND_ARRAY( m_messages, errors );
+        WX_APPEND_ARRAY( m_messages, warnings );
+        --m_inside;
+    }
+
+    wxJSONTestCountMap m_calls;
+    wxJSONValue        m_values;
+    wxArrayString      m_messages;
+    int                m_inside;
+    int                m_overlaps;
+    int                m_errors;
+};
+
+static wxString
+FileName( const wxString& dir, const char* kind, int n )
+{
+    return dir + wxString::Format( _T("wxjson_loader_%s_%d.json"),
+                        wxString::FromUTF8( kind ).c_str(), n );
+}
+
+static void
+WriteFile( const wxString& name, const wxString& text )
+{
+    wxFFile file( name, _T("wb"));
+    if ( !file.IsOpened() || !file.Write( text ))  {
+        printf( "cannot write %s\n", (const char*) name.ToUTF8() );
+        ++s_failures;
+    }
+}
+
+// the valid files hold an object whose "id" member is the file's number
+static void
+WriteFiles( const wxString& dir, wxArrayString& files, wxArrayInt& ids )
+{
+    for ( int i = 0; i < NUM_SMALL; i++ )  {
+        wxString name = FileName( dir, "small", i );
+        WriteFile( name, wxString::Format( _T("{ \"id\" : %d }\n"), i ));
+        files.Add( name );
+        ids.Add( i );
+    }
+    for ( int i = 0; i < NUM_LARGE; i++ )  {
+        wxString name = FileName( dir, "large", i );
+        wxString text = wxString::Format( _T("{ \"id\" : %d, \"data\" : [\n"), 1000 + i );
+        for ( int j = 0; j < 20000 * ( i + 1 ); j++ )  {
+            text += wxString::Format( _T("%d,\n"), j );
+        }
+        text += _T("0 ] }\n");
+        WriteFile( name, text );
+        files.Add( name );
+        ids.Add( 1000 + i );
+    }
+    for ( int i = 0; i < NUM_INVALID; i++ )  {
+        wxString name = FileName( dir, "invalid", i );
+        WriteFile( name, _T("{ \"id\" : : 1 ]\n") );
+        files.Add( name );
+        ids.Add( -1 );
+    }
+    for ( int i = 0; i < NUM_MISSING; i++ )  {
+        files.Add( FileName( dir, "missing", i ));
+        ids.Add( -1 );
+    }
+}
+
+static void
+CheckLoad( const wxArrayString& files, const wxArrayInt& ids,
+           int numThreads, size_t batchSize )
+{
+    int failures = s_failures;
+    TestHandler handler;
+    wxJSONFileLoader loader;
+    loader.SetThreadCount( numThreads );
+    loader.SetBatchSize( batchSize );
+
+    int numFailed = loader.Load( files, handler );
+    if ( numFailed != NUM_INVALID + NUM_MISSING || handler.m_errors != numFailed )  {
+        ++s_failures;
+        printf( "FAIL: %d failed files, %d reported with errors, expected %d\n",
+                numFailed, handler.m_errors, NUM_INVALID + NUM_MISSING );
+    }
+    if ( handler.m_overlaps > 0 )  {
+        ++s_failures;
+        printf( "FAIL: %d overlapping calls to the handler\n", handler.m_overlaps );
+    }
+    if ( handler.m_calls.size() != files.GetCount() )  {
+        ++s_failures;
+        printf( "FAIL: %u files reported instead of %u\n",
+                (unsigned) handler.m_calls.size(), (unsigned) files.GetCount() );
+    }
+    for ( size_t i = 0; i < files.GetCount(); i++ )  {
+        int calls = handler.m_calls[files[i]];
+        if ( calls != 1 )  {
+            ++s_failures;
+            printf( "FAIL: %s reported %d times\n", (const char*) files[i].ToUTF8(), calls );
+            continue;
+        }
+        if ( ids[i] >= 0 && handler.m_values[files[i]]["id"].AsInt() != ids[i] )  {
+            ++s_failures;
+            printf( "FAIL: %s has the wrong value\n", (const char*) files[i].ToUTF8() );
+        }
+    }
+    printf( "%s: %d threads, batch size %u\n", s_failures == failures ? "PASS" : "FAIL",
+            numThreads, (unsigned) batchSize );
+}
+
+int
+main()
+{
+    wxInitializer init;
+    wxString dir = wxFileName::GetTempDir() + wxFileName::GetPathSeparator();
+    wxArrayString files;
+    wxArrayInt    ids;
+
+    WriteFiles( dir, files, ids );
+    if ( s_failures == 0 )  {
+        static const int threads[] = { 1, 2, 4, 8 };
+        for ( size_t i = 0; i < sizeof( threads ) / sizeof( threads[0] ); i++ )  {
+            CheckLoad( files, ids, threads[i], 64 * 1024 );
+            CheckLoad( files, ids, threads[i], 0 );
+        }
+    }
+    for ( size_t i = 0; i < files.GetCount(); i++ )  {
+        if ( wxFileName::FileExists( files[i] ))  {
+            wxRemoveFile( files[i] );
+        }
+    }
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        jsonsegments_bench.cpp
+// Purpose:     compares Parse( const struct iovec*, ...) with reassembly
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ A JSON text of about 8 MB (an array of objects with short and long
+ strings, numbers and nested arrays) is cut into segments of 64, 1460
+ (an Ethernet payload), 4096 and 65536 bytes and parsed in two ways:
+
+   - reassembly: the segments are copied to a contiguous buffer which is
+     parsed by wxJSONReader::Parse( const char*, size_t, wxJSONValue* )
+   - segments: the segments are parsed in place by
+     wxJSONReader::Parse( const struct iovec*, int, wxJSONValue* )
+
+ The best of five runs of each way is printed in MB/s; the program also
+ checks that both ways return the same value.
+
+ The program needs the wxJSON library and wxBase:
+
+   g++ -O2 -I.. jsonsegments_bench.cpp `wx-config --cxxflags --libs base` \
+       -lwxjson -o jsonsegments_bench
+   ./jsonsegments_bench
+*/
+
+#include "jsonreader.h"
+#include "jsonval.h"
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+static const int NUM_RUNS = 5;
+
+static void
+BuildText( wxMemoryBuffer& text, size_t size )
+{
+    char item[512];
+    text.AppendData( "[\n", 2 );
+    for ( int i = 0; text.GetDataLen() < size; i++ )  {
+        int len = snprintf( item, sizeof( item ),
+            "  { \"id\" : %d, \"name\" : \"item number %d\", \"price\" : %d.%02d,\n"
+            "    \"tags\" : [ \"alpha\", \"beta\", \"gamma\" ], \"active\" : %s,\n"
+            "    \"text\" : \"Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+            "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua\" },\n",
+            i, i, i % 1000, i % 100, i % 2 ? "true" : "false" );
+        text.AppendData( item, len );
+    }
+    text.AppendData( "  null\n]\n", 9 );
+}
+
+// returns the time in ms of the fastest run
+static long
+RunReassembly( const struct iovec* iov, int count, size_t size, wxJSONValue* val )
+{
+    long best = -1;
+    char* buff = new char[size];
+    for ( int run = 0; run < NUM_RUNS; run++ )  {
+        wxStopWatch sw;
+        size_t pos = 0;
+        for ( int i = 0; i < count; i++ )  {
+            memcpy( buff + pos, iov[i].iov_base, iov[i].iov_len );
+            pos += iov[i].iov_len;
+        }
+        wxJSONReader reader;
+        *val = wxJSONValue();
+        int numErr = reader.Parse( buff, pos, val );
+        long t = sw.Time();
+        if ( numErr > 0 )  {
+            printf( "reassembly: %d errors\n", numErr );
+        }
+        if ( best < 0 || t < best )  {
+            best = t;
+        }
+    }
+    delete [] buff;
+    return best;
+}
+
+static long
+RunSegments( const struct iovec* iov, int count, wxJSONValue* val )
+{
+    long best = -1;
+    for ( int run = 0; run < NUM_RUNS; run++ )  {
+        wxStopWatch sw;
+        wxJSONReader reader;
+        *val = wxJSONValue();
+        int numErr = reader.Parse( iov, count, val );
+        long t = sw.Time();
+        if ( numErr > 0 )  {
+            printf( "segments: %d errors\n", numErr );
+        }
+        if ( best < 0 || t < best )  {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static double
+MBs( size_t size, long ms )
+{
+    return ms > 0 ? size / 1048576.0 / ( ms / 1000.0 ) : 0.0;
+}
+
+int
+main()
+{
+    wxInitializer init;
+    static const size_t segSizes[] = { 64, 1460, 4096, 65536 };
+
+    wxMemoryBuffer text;
+    BuildText( text, 8 * 1024 * 1024 );
+    const char* data = (const char*) text.GetData();
+    size_t size = text.GetDataLen();
+
+    int result = 0;
+    printf( "text size: %lu bytes\n", (unsigned long) size );
+    printf( "%10s %14s %14s\n", "segment", "reassembly", "segments" );
+    for ( size_t s = 0; s < sizeof( segSizes ) / sizeof( segSizes[0] ); s++ )  {
+        int count = (int) (( size + segSizes[s] - 1 ) / segSizes[s] );
+        struct iovec* iov = new struct iovec[count];
+        for ( int i = 0; i < count; i++ )  {
+            size_t off = i * segSizes[s];
+            iov[i].iov_base = (void*) ( data + off );
+            iov[i].iov_len  = size - off < segSizes[s] ? size - off : segSizes[s];
+        }
+
+        wxJSONValue v1, v2;
+        long t1 = RunReassembly( iov, count, size, &v1 );
+        long t2 = RunSegments( iov, count, &v2 );
+        printf( "%10lu %9.1f MB/s %9.1f MB/s\n", (unsigned long) segSizes[s],
+                MBs( size, t1 ), MBs( size, t2 ));
+        if ( !v1.IsSameAs( v2 ))  {
+            printf( "  the values differ\n" );
+            result = 1;
+        }
+        delete [] iov;
+    }
+    return result;
+}
@@ -0,0 +1,178 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        jsonsimd_test.cpp
+// Purpose:     test matrix of the wxJSONSimd kernels
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ Every level supported by the CPU is selected in turn with
+ wxJSONSimd::SetLevel() and the output of each kernel is compared with the
+ one of the scalar level on the same inputs: all the lengths from 0 to 129,
+ starting at every offset in a 4-byte group, with the byte being searched
+ in every position (the last one included), with high-bit bytes and with
+ random data.
+ Levels not supported by the CPU are reported as skipped.
+
+ The program only needs jsonsimd.cpp:
+
+   g++ -O2 -I.. jsonsimd_test.cpp ../jsonsimd.cpp -o jsonsimd_test
+   ./jsonsimd_test
+
+ It returns zero if all the levels agree with the scalar one.
+*/
+
+#include "jsonsimd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t MAX_LEN = 129;
+static int s_failures = 0;
+
+struct Results
+{
+    const char*   scan;
+    const char*   skip;
+    bool          ascii;
+    size_t        hexBytes;
+    int           hexErrors;
+    unsigned char hexOut[MAX_LEN];
+};
+
+static void
+RunKernels( const char* p, size_t len, Results* r )
+{
+    r->scan  = wxJSONSimd::ScanString( p, p + len );
+    r->skip  = wxJSONSimd::SkipSpaces( p, p + len );
+    r->ascii = wxJSONSimd::IsAscii( p, p + len );
+    r->hexErrors = 0;
+    memset( r->hexOut, 0, sizeof( r->hexOut ));
+    r->hexBytes = wxJSONSimd::HexDecode( p, len / 2, r->hexOut, &r->hexErrors );
+}
+
+// run the kernels of 'level' and of the scalar level on 'p' and compare
+static void
+Check( wxJSONSimdLevel level, const char* what, const char* p, size_t len )
+{
+    Results expected, actual;
+
+    wxJSONSimd::SetLevel( wxJSONSIMD_SCALAR );
+    RunKernels( p, len, &expected );
+    wxJSONSimd::SetLevel( level );
+    RunKernels( p, len, &actual );
+
+    const char* failed = 0;
+    if ( actual.scan != expected.scan )  {
+        failed = "ScanString";
+    }
+    else if ( actual.skip != expected.skip )  {
+        failed = "SkipSpaces";
+    }
+    else if ( actual.ascii != expected.ascii )  {
+        failed = "IsAscii";
+    }
+    else if ( actual.hexBytes != expected.hexBytes ||
+              actual.hexErrors != expected.hexErrors ||
+              memcmp( actual.hexOut, expected.hexOut, expected.hexBytes ) != 0 )  {
+        failed = "HexDecode";
+    }
+    if ( failed != 0 )  {
+        ++s_failures;
+        printf( "FAIL: %s %s, %s input, length %u\n",
+                wxJSONSimd::GetLevelName( level ), failed, what, (unsigned) len );
+    }
+}
+
+// the input is copied at every offset of a 4-byte group so that the
+// kernels are also run on unaligned data
+static void
+CheckAllOffsets( wxJSONSimdLevel level, const char* what, const char* data, size_t len )
+{
+    static char buff[MAX_LEN + 4];
+    for ( size_t offset = 0; offset < 4; offset++ )  {
+        memcpy( buff + offset, data, len );
+        Check( level, what, buff + offset, len );
+    }
+}
+
+static void
+CheckLevel( wxJSONSimdLevel level )
+{
+    static const char special[] = { '\"', '\\', '\x01', '\x1F', ' ', '\t', '\n',
+                                    'G', (char) 0x80, (char) 0xFF };
+    static const char hexDigits[] = "0123456789ABCDEF";
+    char data[MAX_LEN];
+
+    for ( size_t len = 0; len <= MAX_LEN; len++ )  {
+        // plain text: no byte is searched by any kernel
+        memset( data, 'a', len );
+        CheckAllOffsets( level, "plain", data, len );
+
+        // spaces only
+        memset( data, ' ', len );
+        CheckAllOffsets( level, "spaces", data, len );
+
+        // valid hex digits only
+        for ( size_t i = 0; i < len; i++ )  {
+            data[i] = hexDigits[i % 16];
+        }
+        CheckAllOffsets( level, "hex", data, len );
+
+        // one special byte at every position, the last one included
+        for ( size_t pos = 0; pos < len; pos++ )  {
+            for ( size_t k = 0; k < sizeof( special ); k++ )  {
+                memset( data, 'a', len );
+                data[pos] = special[k];
+                CheckAllOffsets( level, "text with special byte", data, len );
+
+                memset( data, ' ', len );
+                data[pos] = special[k];
+                CheckAllOffsets( level, "spaces with special byte", data, len );
+
+                for ( size_t i = 0; i < len; i++ )  {
+                    data[i] = hexDigits[i % 16];
+                }
+                data[pos] = special[k];
+                CheckAllOffsets( level, "hex with special byte", data, len );
+            }
+        }
+
+        // random bytes, with and without the high bit
+        for ( int n = 0; n < 20; n++ )  {
+            for ( size_t i = 0; i < len; i++ )  {
+                data[i] = (char) ( rand() & 0xFF );
+            }
+            CheckAllOffsets( level, "random", data, len );
+            for ( size_t i = 0; i < len; i++ )  {
+                data[i] = (char) ( rand() & 0x7F );
+            }
+            CheckAllOffsets( level, "random ASCII", data, len );
+        }
+    }
+}
+
+int
+main()
+{
+    static const wxJSONSimdLevel levels[] = {
+        wxJSONSIMD_SCALAR, wxJSONSIMD_SSE42, wxJSONSIMD_AVX2, wxJSONSIMD_AVX512
+    };
+
+    srand( 1 );
+    wxJSONSimdLevel maxLevel = wxJSONSimd::GetMaxLevel();
+    for ( size_t i = 0; i < sizeof( levels ) / sizeof( levels[0] ); i++ )  {
+        const char* name = wxJSONSimd::GetLevelName( levels[i] );
+        if ( levels[i] > maxLevel )  {
+            printf( "SKIP: %s is not supported by this CPU\n", name );
+            continue;
+        }
+        int failures = s_failures;
+        if ( wxJSONSimd::SetLevel( levels[i] ) != levels[i] )  {
+            ++s_failures;
+            printf( "FAIL: %s could not be selected\n", name );
+        }
+        CheckLevel( levels[i] );
+        printf( "%s: %s\n", s_failures == failures ? "PASS" : "FAIL", name );
+    }
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        jsonsorted_test.cpp
+// Purpose:     lookups in wxJSONSortedObject
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ A wxJSONSortedObject is filled in a scrambled order with sets of names
+ that share long prefixes ("record-000123", "user_000000042", ...), with
+ names shorter than eight bytes, with names that only differ in their
+ length and with duplicates; then every name is searched and so are
+ names that are not members: before the first member, after the last
+ one, between two members and with the shared prefix only.
+
+ The program needs the wxJSON library and wxBase:
+
+   g++ -O2 -I.. jsonsorted_test.cpp `wx-config --cxxflags --libs base` \
+       -lwxjson -o jsonsorted_test
+   ./jsonsorted_test
+
+ It returns zero if all the lookups give the expected result.
+*/
+
+#include "jsonsorted.h"
+#include "jsonval.h"
+
+#include <stdio.h>
+
+static const int NUM_KEYS = 20000;
+static int s_failures = 0;
+
+static wxString
+RecordKey( const char* format, int n )
+{
+    return wxString::Format( wxString::FromUTF8( format ), n );
+}
+
+static void
+CheckFound( const wxJSONSortedObject& obj, const wxString& key, int expected )
+{
+    const wxJSONValue* value = obj.Find( key );
+    if ( value == 0 || value->AsInt() != expected )  {
+        ++s_failures;
+        printf( "FAIL: '%s' %s\n", (const char*) key.ToUTF8(),
+                value == 0 ? "not found" : "has the wrong value" );
+    }
+}
+
+static void
+CheckMissing( const wxJSONSortedObject& obj, const wxString& key )
+{
+    if ( obj.Find( key ) != 0 )  {
+        ++s_failures;
+        printf( "FAIL: '%s' found but it is not a member\n",
+                (const char*) key.ToUTF8() );
+    }
+}
+
+// all the names have the same 8-byte prefix: the lookup depends on the
+// search among the members with equal prefixes
+static void
+CheckSharedPrefix( const char* format )
+{
+    int failures = s_failures;
+    wxJSONSortedObject obj;
+
+    // a permutation of 0..NUM_KEYS-1 (NUM_KEYS is not a multiple of 7919)
+    for ( int i = 0; i < NUM_KEYS; i++ )  {
+        int n = (int) (( i * 7919L ) % NUM_KEYS );
+        obj.AddMember( RecordKey( format, n ), wxJSONValue( n ));
+    }
+    // duplicates: the last one wins
+    for ( int n = 0; n < NUM_KEYS; n += 97 )  {
+        obj.AddMember( RecordKey( format, n ), wxJSONValue( -n ));
+    }
+    obj.Sort();
+
+    if ( obj.GetCount() != (size_t) NUM_KEYS )  {
+        ++s_failures;
+        printf( "FAIL: %s: %u members instead of %d\n", format,
+                (unsigned) obj.GetCount(), NUM_KEYS );
+    }
+    for ( int n = 0; n < NUM_KEYS; n++ )  {
+        CheckFound( obj, RecordKey( format, n ), n % 97 == 0 ? -n : n );
+    }
+
+    // after the last member, between members and before the first one
+    CheckMissing( obj, RecordKey( format, NUM_KEYS ));
+    CheckMissing( obj, RecordKey( format, 123 ) + _T("5") );
+    CheckMissing( obj, RecordKey( format, 0 ).Left( 8 ));
+    CheckMissing( obj, RecordKey( format, 0 ).Left( 9 ));
+    CheckMissing( obj, wxString() );
+    printf( "%s: %s\n", s_failures == failures ? "PASS" : "FAIL", format );
+}
+
+// names shorter than the prefix and names that only differ in length
+static void
+CheckShortNames()
+{
+    static const char* names[] = {
+        "", "a", "ab", "abc", "abcdefg", "abcdefgh", "abcdefghi",
+        "abcdefghij", "b", "id", "id-1", "id-10", "id-100", "z"
+    };
+    const int count = sizeof( names ) / sizeof( names[0] );
+    int failures = s_failures;
+    wxJSONSortedObject obj;
+
+    for ( int i = count - 1; i >= 0; i-- )  {
+        obj.AddMember( wxString::FromUTF8( names[i] ), wxJSONValue( i ));
+    }
+    obj.Sort();
+    for ( int i = 0; i < count; i++ )  {
+        CheckFound( obj, wxString::FromUTF8( names[i] ), i );
+    }
+    CheckMissing( obj, _T("aa") );
+    CheckMissing( obj, _T("abcdefghijk") );
+    CheckMissing( obj, _T("id-") );
+    CheckMissing( obj, _T("id-1000") );
+    CheckMissing( obj, _T("zz") );
+    printf( "%s: short names\n", s_failures == failures ? "PASS" : "FAIL" );
+}
+
+int
+main()
+{
+    CheckSharedPrefix( "record-%06d" );
+    CheckSharedPrefix( "user_%09d" );
+    CheckSharedPrefix( "id-%08d" );
+    CheckShortNames();
+
+    wxJSONSortedObject empty;
+    CheckMissing( empty, _T("record-000001") );
+
+    return s_failures == 0 ? 0 : 1;
+}